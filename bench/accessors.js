@@ -0,0 +1,105 @@
+/**
+ * Micro benchmark for the Termios flag accessors.
+ *
+ * Checks that Termios instances share a single fast-mode hidden class
+ * regardless of the constructor variant, that a function toggling flags
+ * gets optimized by TurboFan and stays optimized, and compares the
+ * accessor cost to a raw Uint32Array load/store.
+ *
+ * Run with: node bench/accessors.js (also part of bench/index.js)
+ */
+const v8 = require('v8');
+v8.setFlagsFromString('--allow-natives-syntax');
+const { Termios, native } = require('..');
+
+// V8 optimization status bit (stable across node versions)
+const OPTIMIZED = 1 << 4;
+const ROUNDS = 1e7;
+
+const hasFastProperties = new Function('o', 'return %HasFastProperties(o);');
+const haveSameMap = new Function('a', 'b', 'return %HaveSameMap(a, b);');
+const optimizationStatus = new Function('f', 'return %GetOptimizationStatus(f);');
+const prepare = new Function('f', 'try { %PrepareFunctionForOptimization(f); } catch (e) {}');
+const optimize = new Function('f', '%OptimizeFunctionOnNextCall(f);');
+
+const ECHO = native.LFLAGS.ECHO;
+const ICRNL = native.IFLAGS.ICRNL;
+
+function toggle(t) {
+  t.c_lflag &= ~ECHO;
+  t.c_lflag |= ECHO;
+  t.c_iflag ^= ICRNL;
+  return t.c_lflag;
+}
+
+function toggleRaw(flags) {
+  flags[3] &= ~ECHO;
+  flags[3] |= ECHO;
+  flags[0] ^= ICRNL;
+  return flags[3];
+}
+
+function nsPerOp(fn, arg) {
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < ROUNDS; ++i) {
+    fn(arg);
+  }
+  return Number(process.hrtime.bigint() - start) / ROUNDS;
+}
+
+function warmup(fn, arg) {
+  prepare(fn);
+  fn(arg);
+  fn(arg);
+  optimize(fn);
+  fn(arg);
+}
+
+function run() {
+  const variants = {
+    null: new Termios(null),
+    defaults: new Termios(),
+    copy: new Termios(new Termios(null))
+  };
+  if (native.isatty(0)) {
+    variants.fd = new Termios(0);
+  }
+  const reference = variants.null;
+  const instances = {};
+  for (const name of Object.keys(variants)) {
+    instances[name] = {
+      fastProperties: hasFastProperties(variants[name]),
+      sameMap: haveSameMap(reference, variants[name])
+    };
+  }
+
+  const t = new Termios(null);
+  const raw = new Uint32Array(16);
+  warmup(toggle, t);
+  warmup(toggleRaw, raw);
+  const accessorNs = nsPerOp(toggle, t);
+  const rawNs = nsPerOp(toggleRaw, raw);
+  // feeding all constructor variants must not deopt the call site
+  for (const name of Object.keys(variants)) {
+    toggle(variants[name]);
+  }
+  const status = optimizationStatus(toggle);
+
+  const result = {
+    instances,
+    optimized: !!(status & OPTIMIZED),
+    accessorNsPerOp: accessorNs,
+    rawTypedArrayNsPerOp: rawNs
+  };
+  result.ok = result.optimized && Object.keys(instances).every(
+    name => instances[name].fastProperties && instances[name].sameMap);
+  return result;
+}
+
+module.exports = { run };
+
+if (require.main === module) {
+  const result = run();
+  console.log(JSON.stringify(result, null, 2));
+  process.exitCode = result.ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+/**
+ * Benchmark suite for the native call overhead.
+ *
+ * Measures ns/op of the exported native functions, the Termios constructor
+ * variants, the flag accessors and the mode helpers, and the module import
+ * time. All tty calls run on pty pairs allocated by the suite itself, thus
+ * stdin does not need to be a tty.
+ * The results are printed as JSON to track regressions across releases.
+ *
+ * Run with: npm run bench [-- <name filter>]
+ * Set BENCH_ROUNDS to change the iterations per case (default: 100000).
+ */
+const fs = require('fs');
+const path = require('path');
+const { spawnSync } = require('child_process');
+const { Termios, native } = require('..');
+const accessors = require('./accessors');
+
+const ROUNDS = Number(process.env.BENCH_ROUNDS) || 1e5;
+const FILTER = process.argv[2] || '';
+
+// cases and report sections run if their name contains the filter
+function selected(name) {
+  return name.includes(FILTER);
+}
+
+function nsPerOp(fn, rounds) {
+  // warmup - lets the JIT settle before timing
+  for (let i = 0; i < rounds / 10; ++i) {
+    fn();
+  }
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < rounds; ++i) {
+    fn();
+  }
+  return Number(process.hrtime.bigint() - start) / rounds;
+}
+
+function cases(pair) {
+  const { master, slave } = pair;
+  const buffer = Buffer.alloc(native.EXPLAIN.size);
+  native.tcgetattr(slave, buffer);
+  const t = new Termios(slave);
+  const { ECHO } = native.LFLAGS;
+  const { B9600 } = native.BAUD;
+  const { TCSANOW } = native.ACTION;
+  return {
+    'native.isatty': () => native.isatty(slave),
+    'native.ttyname': () => native.ttyname(slave),
+    'native.ptsname': () => native.ptsname(master),
+    'native.tcgetattr': () => native.tcgetattr(slave, buffer),
+    'native.tcsetattr': () => native.tcsetattr(slave, TCSANOW, buffer),
+    'native.cfgetispeed': () => native.cfgetispeed(buffer),
+    'native.cfgetospeed': () => native.cfgetospeed(buffer),
+    'native.cfsetispeed': () => native.cfsetispeed(buffer, B9600),
+    'native.cfsetospeed': () => native.cfsetospeed(buffer, B9600),
+    'Termios(fd)': () => new Termios(slave),
+    'Termios(null)': () => new Termios(null),
+    'Termios()': () => new Termios(),
+    'Termios(termios)': () => new Termios(t),
+    'Termios.c_lflag get': () => t.c_lflag,
+    'Termios.c_lflag set': () => { t.c_lflag ^= ECHO; },
+    'Termios.setraw': () => t.setraw(),
+    'Termios.setcbreak': () => t.setcbreak(),
+    'Termios.setcooked': () => t.setcooked()
+  };
+}
+
+/**
+ * Import-to-ready time in msec (median of fresh processes),
+ * with and without touching all symbol groups.
+ */
+function importTime(touchSymbols) {
+  const script = `
+    const start = process.hrtime.bigint();
+    const { native } = require(${JSON.stringify(path.join(__dirname, '..'))});
+    if (${touchSymbols}) {
+      for (const group of native.SYMBOL_GROUPS.concat(['ALL_SYMBOLS', 'EXPLAIN'])) native[group];
+    }
+    console.log(Number(process.hrtime.bigint() - start) / 1e6);`;
+  const times = [];
+  for (let i = 0; i < 11; ++i) {
+    times.push(Number(spawnSync(process.execPath, ['-e', script]).stdout));
+  }
+  return times.sort((a, b) => a - b)[times.length >> 1];
+}
+
+function main() {
+  const [pair] = native.openpty();
+  const results = {};
+  try {
+    const all = cases(pair);
+    for (const name of Object.keys(all)) {
+      if (selected(name)) {
+        results[name] = nsPerOp(all[name], ROUNDS);
+      }
+    }
+  } finally {
+    fs.closeSync(pair.master);
+    fs.closeSync(pair.slave);
+  }
+  const report = {
+    node: process.version,
+    platform: process.platform,
+    arch: process.arch,
+    rounds: ROUNDS,
+    nsPerOp: results
+  };
+  if (selected('importMs')) {
+    report.importMs = importTime(false);
+    report.importAllSymbolsMs = importTime(true);
+  }
+  if (selected('accessors')) {
+    report.accessors = accessors.run();
+    process.exitCode = report.accessors.ok ? 0 : 1;
+  }
+  console.log(JSON.stringify(report, null, 2));
+}
+
+main();
@@ -5,10 +5,31 @@
       "sources":
         [
           "src/termios_basic.cpp",
+          "src/termios_async.cpp",
+          "src/termios_cache.cpp",
+          "src/termios_speed.cpp",
+          "src/termios_pty.cpp",
+          "src/termios_raw.cpp",
+          "src/termios_shared.cpp",
+          "src/termios_symbols.cpp",
+          "src/termios_stty.cpp",
+          "src/termios_translate.cpp",
+          "src/termios_parmrk.cpp",
+          "src/termios_winsize.cpp",
+          "src/termios_stats.cpp",
+          "src/termios_snapshot.cpp",
+          "src/tty_reader.cpp",
+          "src/tty_mux.cpp",
+          "src/tty_framer.cpp",
           "src/node_termios.cpp"
         ],
       "include_dirs" : ['<!(node -e "require(\'nan\')")'],
-      "cflags": ["-std=c++11"]
+      "cflags": ["-std=c++11"],
+      "conditions": [
+        ["OS=='linux'", {
+          "sources": ["src/termios2_linux.cpp"]
+        }]
+      ]
     }
   ]
 }
@@ -1,4 +1,30 @@
 // do not build native module on windows
 if (process.platform !== 'win32') {
-    require('child_process').spawnSync('node-gyp', ['rebuild'], {stdio: 'inherit'});
+    const result = require('child_process').spawnSync('node-gyp', ['rebuild'], {stdio: 'inherit'});
+    if (result.status === 0) {
+        generateConstants();
+    }
+}
+
+/**
+ * Write the symbol tables and EXPLAIN of this platform into a constants module
+ * (build/Release/constants.js), that gets loaded by lib/index.js instead of
+ * materializing the native symbol objects at runtime. The symbol groups are frozen.
+ */
+function generateConstants() {
+    const fs = require('fs');
+    const path = require('path');
+    const native = require('./build/Release/termios.node');
+    const lines = [
+        '// generated by install.js - do not edit',
+        '\'use strict\';',
+        'const freeze = Object.freeze;',
+        'module.exports = freeze({'
+    ];
+    for (const group of native.SYMBOL_GROUPS.concat(['ALL_SYMBOLS'])) {
+        lines.push(`  ${group}: freeze(${JSON.stringify(native[group])}),`);
+    }
+    lines.push(`  EXPLAIN: ${JSON.stringify(native.EXPLAIN)}`);
+    lines.push('});', '');
+    fs.writeFileSync(path.join(__dirname, 'build', 'Release', 'constants.js'), lines.join('\n'));
 }
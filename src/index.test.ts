@@ -1,7 +1,10 @@
 import { assert } from 'chai';
-import { native, Termios } from '.';
+import { native, Termios, CancelToken, tcdrainAsync, tcsetattrAsync, TtyReadStream,
+  TtyWriteStream, SttyPatch, Translator,
+  ParmrkDecoder, TtyMux, TtyWriter, getWinsize, setWinsize, setWinsizeMany,
+  openSnapshotStore, closeSnapshotStore, restoreAll, TermiosPool, TtyFramer } from '.';
 import * as pty from 'node-pty';
-import { platform } from 'os';
+import { platform, tmpdir } from 'os';
 
 /**
  * Note: Tests need stdin (0) to be a real TTY.
@@ -38,19 +41,15 @@ describe('native functions', () => {
     });
   });
   describe('ptsname', () => {
-    it('should return path string on pty master fd', (done) => {
-      const p = pty.spawn('sh', [], {});
-      const path = native.ptsname((p as any)._fd);
+    it('should return path string on pty master fd', () => {
+      const fs = require('fs');
+      const [pair] = native.openpty();
+      const path = native.ptsname(pair.master);
       assert.notEqual(path, '');
-      const fromPty: string[] = [];
-      p.onData(data => fromPty.push(data));
-      p.write('tty\r');  // report ttyname from slave end
-      setTimeout(() => {
-        p.kill();
-        // ttyname on slave should return ptsname on master
-        assert.equal(fromPty.join('').includes(path), true);
-        done();
-      }, 100);
+      // ttyname on slave should return ptsname on master
+      assert.equal(native.ttyname(pair.slave), path);
+      fs.closeSync(pair.master);
+      fs.closeSync(pair.slave);
     });
     it('should return empty string on non pty master fd', () => {
       const fs = require('fs');
@@ -60,13 +59,142 @@ describe('native functions', () => {
       assert.equal(native.ptsname(0), '');
     });
   });
+  describe('openpty', () => {
+    it('allocates pty pairs', () => {
+      const fs = require('fs');
+      const pairs = native.openpty({count: 3});
+      assert.equal(pairs.length, 3);
+      for (const pair of pairs) {
+        assert.equal(native.ptsname(pair.master), pair.path);
+        assert.equal(native.ttyname(pair.slave), pair.path);
+        fs.closeSync(pair.master);
+        fs.closeSync(pair.slave);
+      }
+    });
+    it('applies termios data', () => {
+      const fs = require('fs');
+      const t = new Termios(0);
+      t.c_lflag &= ~native.LFLAGS.ECHO;
+      const [pair] = native.openpty({termios: (t as any)._data, winsize: {rows: 50, cols: 132}});
+      assert.equal(new Termios(pair.slave).c_lflag & native.LFLAGS.ECHO, 0);
+      fs.closeSync(pair.master);
+      fs.closeSync(pair.slave);
+    });
+    it('throws on wrong arguments', () => {
+      assert.throws(() => native.openpty({count: 0}), 'usage: termios.openpty');
+      assert.throws(() => native.openpty({count: 1e6}), 'usage: termios.openpty');
+      assert.throws(() => native.openpty({termios: Buffer.alloc(3)}), 'wrong buffer type');
+    });
+  });
+  describe('winsize', () => {
+    it('get/set', () => {
+      const fs = require('fs');
+      const [pair] = native.openpty({winsize: {rows: 50, cols: 132}});
+      assert.deepEqual(getWinsize(pair.slave), {rows: 50, cols: 132, xpixel: 0, ypixel: 0});
+      setWinsize(pair.master, {rows: 24, cols: 80, xpixel: 640, ypixel: 480});
+      assert.deepEqual(getWinsize(pair.slave), {rows: 24, cols: 80, xpixel: 640, ypixel: 480});
+      assert.throws(() => getWinsize(-1), /getwinsize failed/);
+      fs.closeSync(pair.master);
+      fs.closeSync(pair.slave);
+    });
+    it('setWinsizeMany', () => {
+      const fs = require('fs');
+      const pairs = native.openpty({count: 2});
+      const result = setWinsizeMany([pairs[0].master, -1, pairs[1].master], [
+        {rows: 10, cols: 20}, {rows: 1, cols: 1}, {rows: 30, cols: 40}]);
+      assert.deepEqual(result.map(Boolean), [false, true, false]);
+      assert.equal(getWinsize(pairs[1].slave).cols, 40);
+      for (const pair of pairs) {
+        fs.closeSync(pair.master);
+        fs.closeSync(pair.slave);
+      }
+    });
+    it('cache', () => {
+      const fs = require('fs');
+      const [pair] = native.openpty({winsize: {rows: 50, cols: 132}});
+      native.winsize_cache_enable(true);
+      try {
+        getWinsize(pair.master);
+        const hits = native.winsize_cache_stats().hits;
+        assert.equal(getWinsize(pair.master).cols, 132);
+        assert.equal(native.winsize_cache_stats().hits, hits + 1);
+        // setwinsize updates the entry
+        setWinsize(pair.master, {rows: 24, cols: 80});
+        assert.equal(getWinsize(pair.master).cols, 80);
+        assert.equal(native.winsize_cache_stats().hits, hits + 2);
+        const generation = native.winsize_cache_stats().generation;
+        native.winsize_invalidate();
+        assert.equal(native.winsize_cache_stats().generation, generation + 1);
+        getWinsize(pair.master);
+        assert.equal(native.winsize_cache_stats().hits, hits + 2);
+        // resizing the master drops the cached size of the slave
+        getWinsize(pair.slave);
+        setWinsize(pair.master, {rows: 30, cols: 100});
+        assert.equal(getWinsize(pair.slave).cols, 100);
+      } finally {
+        native.winsize_cache_enable(false);
+      }
+      fs.closeSync(pair.master);
+      fs.closeSync(pair.slave);
+    });
+    it('cache belongs to the enabling thread', done => {
+      const { Worker } = require('worker_threads');
+      const worker = new Worker(`
+        const { native } = require('.');
+        native.winsize_cache_enable(true);
+        require('worker_threads').parentPort.postMessage('enabled');
+        setInterval(() => {}, 1000);`
+        , {eval: true});
+      worker.once('message', () => {
+        assert.throws(() => native.winsize_cache_enable(false), /owned by another thread/);
+        worker.terminate().then(() => {
+          // disabled with the exit of the owning thread
+          assert.equal(native.winsize_cache_stats().enabled, false);
+          native.winsize_cache_enable(true);
+          native.winsize_cache_enable(false);
+          done();
+        });
+      });
+    });
+  });
+  describe('inq/outq', () => {
+    it('report queued bytes on pty', (done) => {
+      const fs = require('fs');
+      const [pair] = native.openpty();
+      fs.writeSync(pair.master, 'abc\r');  // canonical mode counts complete lines only
+      setTimeout(() => {
+        assert.equal(native.inq(pair.slave), 4);
+        assert.isAtLeast(native.outq(pair.slave), 0);
+        fs.closeSync(pair.master);
+        fs.closeSync(pair.slave);
+        done();
+      }, 50);
+    });
+    it('throw on non tty fd', () => {
+      assert.throws(() => native.inq(-1), 'inq failed');
+      assert.throws(() => native.outq(-1), 'outq failed');
+    });
+    it('batch versions report -errno per fd', () => {
+      assert.deepEqual(native.inq_many([-1]), [-9]);  // EBADF
+      assert.deepEqual(native.outq_many([0, -1]).map(v => v < 0), [false, true]);
+    });
+  });
   describe('tcgetattr', () => {
     it('should load data into buffer', () => {
       const buf = Buffer.from(Array(native.EXPLAIN.size));
       native.tcgetattr(0, buf);
       assert.notDeepEqual(buf, Buffer.from(Array(native.EXPLAIN.size)));
     });
+    it('should accept typed array views', () => {
+      const buf = Buffer.alloc(native.EXPLAIN.size);
+      native.tcgetattr(0, buf);
+      const view = new Uint8Array(native.EXPLAIN.size);
+      native.tcgetattr(0, view as Buffer);
+      assert.deepEqual(Buffer.from(view), buf);
+      assert.equal(native.cfgetospeed(view as Buffer), native.cfgetospeed(buf));
+    });
     it('should reject wrong arguments', () => {
+      assert.throws(() => native.tcgetattr('0' as any, Buffer.alloc(native.EXPLAIN.size)), 'Usage');
       // illegal fd
       assert.throws(() => native.tcgetattr(-1, Buffer.from(Array(native.EXPLAIN.size))));
       const fs = require('fs');
@@ -108,12 +236,173 @@ describe('native functions', () => {
       assert.throws(() => native.tcsetattr(0, native.ACTION.TCSANOW, Buffer.from(Array(10))), 'wrong buffer type');
     });
   });
+  describe('raw', () => {
+    it('return 0 on success', () => {
+      const buf = Buffer.alloc(native.EXPLAIN.size);
+      assert.equal(native.raw.isatty(0), 1);
+      assert.equal(native.raw.tcgetattr(0, buf), 0);
+      assert.equal(native.raw.tcsetattr(0, native.ACTION.TCSANOW, buf), 0);
+      assert.equal(native.raw.tcdrain(0), 0);
+    });
+    it('return negative errno instead of throwing', () => {
+      const buf = Buffer.alloc(native.EXPLAIN.size);
+      const fs = require('fs');
+      const fd = fs.openSync('/', 'r');
+      assert.equal(native.raw.isatty(fd), 0);
+      assert.equal(native.raw.isatty(-1), -native.ERRNO.EBADF);
+      assert.equal(native.raw.tcgetattr(-1, buf), -native.ERRNO.EBADF);
+      assert.equal(native.raw.tcgetattr(fd, buf), -native.ERRNO.ENOTTY);
+      assert.equal(native.raw.tcsetattr(fd, native.ACTION.TCSANOW, buf), -native.ERRNO.ENOTTY);
+      assert.equal(native.raw.tcflush(fd, native.FLUSH.TCIFLUSH), -native.ERRNO.ENOTTY);
+      assert.equal(native.raw.tcflow(-1, native.FLOW.TCOON), -native.ERRNO.EBADF);
+      assert.equal(native.raw.tcdrain(-1), -native.ERRNO.EBADF);
+      fs.closeSync(fd);
+      // wrong arguments
+      assert.equal(native.raw.tcgetattr(0, Buffer.alloc(3)), -native.ERRNO.EINVAL);
+      assert.equal((native.raw as any).tcdrain(), -native.ERRNO.EINVAL);
+    });
+    it('errname and strerror', () => {
+      assert.equal(native.raw.errname(-native.ERRNO.ENOTTY), 'ENOTTY');
+      assert.equal(native.raw.errname(123456), '');
+      assert.isString(native.raw.strerror(-native.ERRNO.EBADF));
+    });
+  });
+  describe('stats', () => {
+    afterEach(() => native.stats_enable(false));
+    it('counts calls, errors and latencies', () => {
+      native.resetStats();
+      const buffer = (new Termios(null) as any)._data;
+      native.tcgetattr(0, buffer);
+      assert.equal(native.stats().ops.tcgetattr.calls, 0);
+      native.stats_enable(true);
+      native.tcgetattr(0, buffer);
+      native.tcsetattr(0, native.ACTION.TCSANOW, buffer);
+      assert.throws(() => native.tcgetattr(-1, buffer));
+      const stats = native.stats();
+      assert.equal(stats.enabled, true);
+      assert.equal(stats.ops.tcgetattr.calls, 2);
+      assert.equal(stats.ops.tcgetattr.errors, 1);
+      assert.deepEqual(stats.ops.tcgetattr.errno, {EBADF: 1});
+      assert.equal(stats.ops.tcgetattr.histogram.reduce((a, b) => a + b, 0), 2);
+      assert.equal(stats.ops.tcsetattr.calls, 1);
+      native.resetStats();
+      assert.equal(native.stats().ops.tcgetattr.calls, 0);
+    });
+  });
+  describe('termios cache', () => {
+    afterEach(() => native.cache_enable(false));
+    it('skips tcsetattr for unchanged data', () => {
+      native.cache_enable(true);
+      const attrs = Buffer.from(Array(native.EXPLAIN.size));
+      native.tcgetattr(0, attrs);
+      const before = native.cache_stats();
+      native.tcsetattr(0, native.ACTION.TCSAFLUSH, attrs);
+      native.tcsetattr(0, native.ACTION.TCSAFLUSH, attrs);
+      const after = native.cache_stats();
+      assert.equal(after.enabled, true);
+      assert.equal(after.hits - before.hits, 2);
+      assert.isAtLeast(after.entries, 1);
+    });
+    it('applies changed data and honors invalidation', () => {
+      native.cache_enable(true);
+      const attrs = Buffer.from(Array(native.EXPLAIN.size));
+      native.tcgetattr(0, attrs);
+      native.cache_invalidate(0);
+      const before = native.cache_stats();
+      native.tcsetattr(0, native.ACTION.TCSANOW, attrs);
+      assert.equal(native.cache_stats().misses - before.misses, 1);
+      native.cache_invalidate();
+      assert.equal(native.cache_stats().entries, 0);
+    });
+    it('tracks fds sharing a tty', () => {
+      const fs = require('fs');
+      const [pair] = native.openpty();
+      const alias = fs.openSync(pair.path, fs.constants.O_RDWR | fs.constants.O_NOCTTY);
+      const cooked = new Termios(pair.slave);
+      const raw = new Termios(cooked);
+      raw.setraw();
+      native.cache_enable(true);
+      raw.writeTo(pair.slave, native.ACTION.TCSANOW);
+      cooked.writeTo(alias, native.ACTION.TCSANOW);
+      raw.writeTo(pair.slave, native.ACTION.TCSANOW);
+      assert.equal(new Termios(alias).c_lflag & native.LFLAGS.ICANON, 0);
+      // master and slave share the settings as well (not on solaris)
+      if (platform() !== 'sunos') {
+        cooked.writeTo(pair.master, native.ACTION.TCSANOW);
+        raw.writeTo(pair.slave, native.ACTION.TCSANOW);
+        native.cache_invalidate();
+        assert.equal(new Termios(pair.slave).c_lflag & native.LFLAGS.ICANON, 0);
+      }
+      fs.closeSync(alias);
+      fs.closeSync(pair.master);
+      fs.closeSync(pair.slave);
+    });
+    it('disabled cache holds no entries', () => {
+      native.cache_enable(false);
+      native.tcgetattr(0, Buffer.from(Array(native.EXPLAIN.size)));
+      assert.equal(native.cache_stats().enabled, false);
+      assert.equal(native.cache_stats().entries, 0);
+    });
+  });
+  describe('snapshot store', () => {
+    const fs = require('fs');
+    const file = require('path').join(tmpdir(), `termios-snapshot-${process.pid}`);
+    afterEach(() => {
+      closeSnapshotStore();
+      fs.unlinkSync(file);
+    });
+    it('records the state before the first change and restores it', () => {
+      const pair = native.openpty({winsize: {rows: 30, cols: 100}})[0];
+      assert.equal(openSnapshotStore(file, 8), 8);
+      const original = new Termios(pair.slave);
+      const t = new Termios(original);
+      t.setraw();
+      t.writeTo(pair.slave);
+      t.c_lflag |= native.LFLAGS.ECHO;
+      t.writeTo(pair.slave);
+      setWinsize(pair.master, {rows: 10, cols: 20});
+      const result = restoreAll(file);
+      assert.equal(result.length, 1);
+      assert.equal(result[0].path, pair.path);
+      assert.equal(result[0].error, 0);
+      assert.deepEqual(new Termios(pair.slave).describe(), original.describe());
+      assert.equal(getWinsize(pair.master).cols, 100);
+      assert.equal(native.snapshot_forget(pair.slave), true);
+      assert.equal(restoreAll(file).length, 0);
+      fs.closeSync(pair.master);
+      fs.closeSync(pair.slave);
+    });
+    it('rejects foreign files', () => {
+      fs.writeFileSync(file, Buffer.alloc(256, 1));
+      assert.throws(() => openSnapshotStore(file), /incompatible snapshot file/);
+      assert.throws(() => restoreAll(file), /incompatible snapshot file/);
+    });
+  });
   /**
    * Note tested:
    *    tcsendbreak, tcdrain, tcflush, tcflow
    */
 });
 
+describe('symbols', () => {
+  it('groups are listed in SYMBOL_GROUPS', () => {
+    assert.includeMembers(native.SYMBOL_GROUPS,
+      ['IFLAGS', 'OFLAGS', 'CFLAGS', 'LFLAGS', 'CC', 'ACTION', 'FLUSH', 'FLOW', 'BAUD', 'PKT']);
+  });
+  it('ALL_SYMBOLS holds the symbols of all groups', () => {
+    for (const group of native.SYMBOL_GROUPS) {
+      const symbols = (native as any)[group];
+      for (const name of Object.keys(symbols)) {
+        assert.equal((native.ALL_SYMBOLS as any)[name], symbols[name]);
+      }
+    }
+  });
+  it('same object on repeated access', () => {
+    assert.strictEqual(native.LFLAGS, native.LFLAGS);
+    assert.strictEqual(native.EXPLAIN, native.EXPLAIN);
+  });
+});
+
 describe('Termios', () => {
   it('ctor from valid tty fd', () => {
     const t = new Termios(0);
@@ -200,6 +489,55 @@ describe('Termios', () => {
     assert.notEqual(t.c_lflag & native.LFLAGS.ECHO, 0);
     assert.notEqual(t.c_lflag & native.LFLAGS.ICANON, 0);
   });
+  it('termios primitives are enumerable and serializable', () => {
+    const t = new Termios(0);
+    const keys: string[] = [];
+    for (const key in t) keys.push(key);
+    for (const name of ['c_iflag', 'c_oflag', 'c_cflag', 'c_lflag', 'c_cc']) {
+      assert.include(keys, name);
+    }
+    assert.equal(JSON.parse(JSON.stringify(t)).c_lflag, t.c_lflag);
+    // c_cc is a stable view into the struct data
+    assert.strictEqual(t.c_cc, t.c_cc);
+  });
+  it('loadMany / writeMany', () => {
+    const t1 = new Termios(null);
+    const t2 = new Termios(null);
+    const result = Termios.loadMany([0, 12345], [t1, t2]);
+    assert.equal(result[0], 0);
+    assert.notEqual(result[1], 0);
+    assert.deepEqual((t1 as any)._data, (new Termios(0) as any)._data);
+    // failed fd leaves termios untouched
+    assert.equal(t2.c_lflag, 0);
+    assert.deepEqual(Termios.writeMany([0, -1], [t1, t1], native.ACTION.TCSANOW).map(Boolean), [false, true]);
+    assert.throws(() => Termios.loadMany([0], []));
+  });
+  it('TermiosPool', () => {
+    const pool = new TermiosPool(4);
+    assert.equal(pool.slab.length, 4 * native.EXPLAIN.size);
+    const t1 = pool.acquire(0);
+    const t2 = pool.acquire(t1);
+    assert.equal(pool.size, 2);
+    assert.deepEqual((t2 as any)._data, (new Termios(0) as any)._data);
+    assert.equal((t2 as any)._data.buffer, pool.slab.buffer);
+    // views and slots get reused
+    const index = pool.indexOf(t2);
+    pool.release(t2);
+    assert.throws(() => pool.release(t2), 'termios not acquired from this pool');
+    const t3 = pool.acquire(null);
+    assert.strictEqual(t3, t2);
+    assert.equal(pool.indexOf(t3), index);
+    assert.equal(t3.c_lflag, 0);
+    pool.acquire(null);
+    pool.acquire(null);
+    assert.throws(() => pool.acquire(null), 'pool exhausted');
+    assert.throws(() => pool.release(new Termios(null)), 'termios not acquired from this pool');
+    // batch calls on slots
+    assert.deepEqual(pool.loadAll([-1, 0]), [-native.ERRNO.EBADF, 0]);
+    assert.equal(t3.c_lflag, t1.c_lflag);
+    assert.deepEqual(pool.writeAll([0, 0], native.ACTION.TCSANOW), [0, 0]);
+    assert.throws(() => pool.loadAll([0, 0, 0, 0, 0]), 'more fds than pool slots');
+  });
   it('speed methods', () => {
     // note that nowadays both speeds are normally entangled,
     // thus setting one also applies to the other one
@@ -213,6 +551,469 @@ describe('Termios', () => {
     t.setOutputSpeed(native.BAUD.B75);
     assert.equal(t.getOutputSpeed(), native.BAUD.B75);
   });
+  it('bit rate speed methods', () => {
+    assert.equal(native.baud_to_rate(native.BAUD.B9600), 9600);
+    assert.equal(native.rate_to_baud(115200), native.BAUD.B115200);
+    assert.equal(native.rate_to_baud(31250), -1);
+    const t = new Termios(0);
+    t.setSpeed(115200);
+    assert.equal(t.getOutputSpeed(), native.BAUD.B115200);
+    assert.equal(t.getRate(), 115200);
+    // B* constants are still accepted
+    t.setSpeed(native.BAUD.B9600);
+    assert.equal(t.getRate(), 9600);
+    if (native.ARBITRARY_BAUD) {
+      t.setSpeed(250000);
+      assert.equal(t.getRate(), 250000);
+    } else {
+      assert.throws(() => t.setSpeed(250000));
+    }
+  });
+  it('arbitrary bit rate on pty', function(): void {
+    if (!native.ARBITRARY_BAUD) this.skip();
+    const fs = require('fs');
+    const [pair] = native.openpty();
+    const fd = pair.slave;
+    const t = new Termios(fd);
+    t.setSpeed(31250);
+    t.writeTo(fd, native.ACTION.TCSANOW);
+    assert.equal(new Termios(fd).getRate(), 31250);
+    t.setSpeed(115200);
+    t.writeTo(fd, native.ACTION.TCSANOW);
+    assert.equal(new Termios(fd).getOutputSpeed(), native.BAUD.B115200);
+    fs.closeSync(pair.slave);
+    fs.closeSync(pair.master);
+  });
+  it('stty settings', () => {
+    const s = native.ALL_SYMBOLS;
+    const raw = new Termios(0);
+    raw.setraw();
+    const t = new Termios(0);
+    t.stty(new SttyPatch('raw'));
+    assert.deepEqual(t.toJSON(), raw.toJSON());
+    t.stty('echo -icanon cs7 intr ^X erase ^? min 5 9600');
+    assert.equal(t.c_lflag & (s.ECHO | s.ICANON), s.ECHO);
+    assert.equal(t.c_cflag & s.CSIZE, s.CS7);
+    assert.equal(t.c_cc[s.VINTR], 24);
+    assert.equal(t.c_cc[s.VERASE], 127);
+    assert.equal(t.c_cc[s.VMIN], 5);
+    assert.equal(t.getRate(), 9600);
+    const desc = t.describe();
+    assert.equal(desc.speed, 9600);
+    assert.include(desc.lflag, 'echo');
+    assert.include(desc.lflag, '-icanon');
+    assert.include(desc.cflag, 'cs7');
+    assert.equal(desc.cc.intr, '^X');
+    assert.include(t.toStty(), 'speed 9600 baud;');
+    assert.throws(() => new SttyPatch('echo nonsense'), /unknown setting 'nonsense'/);
+    assert.throws(() => new SttyPatch('min'), /missing value/);
+    assert.throws(() => new SttyPatch('-cs8'));
+  });
+  it('enterRaw / setmode', () => {
+    const fs = require('fs');
+    const [pair] = native.openpty();
+    const before = new Termios(pair.slave);
+    const handle = Termios.enterRaw(pair.slave);
+    assert.deepEqual(handle.previous.toJSON(), before.toJSON());
+    const raw = new Termios(before);
+    raw.setraw();
+    assert.deepEqual(new Termios(pair.slave).toJSON(), raw.toJSON());
+    handle.restore();
+    assert.deepEqual(new Termios(pair.slave).toJSON(), before.toJSON());
+    native.setmode(pair.slave, native.MODE.CBREAK, native.ACTION.TCSANOW);
+    assert.equal(new Termios(pair.slave).c_lflag & (native.LFLAGS.ECHO | native.LFLAGS.ICANON), 0);
+    assert.throws(() => native.setmode(pair.slave, native.MODE.SNAPSHOT, native.ACTION.TCSANOW), 'wrong buffer type');
+    assert.throws(() => native.setmode(pair.slave, 42, native.ACTION.TCSANOW), /unsupported preset/);
+    assert.throws(() => Termios.enterMode(pair.slave, native.MODE.SNAPSHOT), /does not support MODE.SNAPSHOT/);
+    fs.closeSync(pair.master);
+    fs.closeSync(pair.slave);
+  });
+});
+
+describe('Translator', () => {
+  const s = native.ALL_SYMBOLS;
+  it('output rules', () => {
+    const t = new Termios(null);
+    t.c_oflag = s.OPOST | s.ONLCR;
+    const tr = new Translator(t);
+    // long enough to pass the SIMD path
+    const text = 'a long line of text without any newline characters\nnext line\n';
+    assert.equal(tr.translate(Buffer.from(text)).toString(), text.replace(/\n/g, '\r\n'));
+    t.c_oflag = s.ONLCR;
+    assert.equal(tr.translate(Buffer.from('x\n')).toString(), 'x\n');
+  });
+  it('ONOCR column across chunks', () => {
+    const t = new Termios(null);
+    t.c_oflag = s.OPOST | s.ONOCR;
+    const tr = new Translator(t);
+    assert.equal(tr.translate(Buffer.from('\rabc')).toString(), 'abc');
+    assert.equal(tr.translate(Buffer.from('\r\r')).toString(), '\r');
+    tr.translate(Buffer.from('x'));
+    tr.reset();
+    assert.equal(tr.translate(Buffer.from('\r')).toString(), '');
+  });
+  it('input rules', () => {
+    const t = new Termios(null);
+    t.c_iflag = s.ICRNL | s.ISTRIP;
+    const tr = new Translator(t, native.TRANSLATE.INPUT);
+    assert.deepEqual(tr.translate(Buffer.from([0x61, 0x0d, 0xe1, 0x0a])), Buffer.from([0x61, 0x0a, 0x61, 0x0a]));
+    t.c_iflag = s.IGNCR | s.INLCR;
+    assert.equal(tr.translate(Buffer.from('a\r\nb')).toString(), 'a\rb');
+  });
+  it('shared termios', () => {
+    const t = Termios.createShared(null);
+    t.c_oflag = s.OPOST | s.ONLCR;
+    const tr = new Translator(t);
+    assert.equal(tr.translate(Buffer.from('x\n')).toString(), 'x\r\n');
+    t.update(x => assert.equal(new Translator(x).translate(Buffer.from('x\n')).toString(), 'x\r\n'));
+  });
+  it('throws on small output', () => {
+    const t = new Termios(null);
+    assert.throws(() => native.translate((t as any)._data, native.TRANSLATE.OUTPUT, Buffer.alloc(4), Buffer.alloc(4)),
+      /output too small/);
+  });
+});
+
+describe('ParmrkDecoder', () => {
+  const s = native.ALL_SYMBOLS;
+  it('decodes marked input', () => {
+    const t = new Termios(null);
+    t.c_iflag = s.PARMRK | s.INPCK;
+    const decoder = new ParmrkDecoder(t);
+    const plain = Buffer.from('no markers');
+    assert.strictEqual(decoder.decode(plain), plain);
+    // escaped \377, error on 'x', marker split across chunks
+    assert.deepEqual(decoder.decode(Buffer.from([0x61, 0xff, 0xff, 0x62, 0xff, 0, 0x78, 0x63, 0xff])),
+      Buffer.from([0x61, 0xff, 0x62, 0x63]));
+    assert.deepEqual(decoder.errors, [{offset: 3, kind: native.PARMRK.ERROR, value: 0x78}]);
+    assert.deepEqual(decoder.decode(Buffer.from([0, 0, 0x64])), Buffer.from([0x64]));
+    assert.deepEqual(decoder.errors, [{offset: 0, kind: native.PARMRK.BREAK, value: 0}]);
+    assert.deepEqual(decoder.stats, {bytes: 15, errors: 1, breaks: 1, escaped: 1, dropped: 0});
+  });
+  it('keeps a stray \\377 split across chunks', () => {
+    const t = new Termios(null);
+    t.c_iflag = s.PARMRK | s.INPCK;
+    const decoder = new ParmrkDecoder(t);
+    assert.deepEqual(decoder.decode(Buffer.from('x\xff', 'latin1')), Buffer.from('x'));
+    assert.deepEqual(decoder.decode(Buffer.from('abcd')), Buffer.from('\xffabcd', 'latin1'));
+    // output must hold the carried byte in front of the chunk
+    const state = new Uint32Array(native.PARMRK.STATE_SIZE);
+    state[0] = 1;
+    assert.throws(() => native.parmrk_decode((t as any)._data, Buffer.from('abcd'), Buffer.alloc(4),
+      state, new Uint32Array(6)), /output too small/);
+  });
+  it('shared termios', () => {
+    const t = Termios.createShared(null);
+    t.c_iflag = s.PARMRK | s.INPCK;
+    const decoder = new ParmrkDecoder(t);
+    assert.deepEqual(decoder.decode(Buffer.from([0x61, 0xff, 0xff])), Buffer.from([0x61, 0xff]));
+  });
+  it('passes input without PARMRK', () => {
+    const t = new Termios(null);
+    const decoder = new ParmrkDecoder(t);
+    const data = Buffer.from([0xff, 0, 0]);
+    assert.strictEqual(decoder.decode(data), data);
+    assert.deepEqual(decoder.errors, []);
+  });
+});
+
+describe('async functions', () => {
+  it('tcdrainAsync resolves on tty', () => {
+    return tcdrainAsync(0);
+  });
+  it('tcdrainAsync rejects for illegal fd', () => {
+    return tcdrainAsync(12345).then(
+      () => assert.fail('should not resolve'),
+      (err: Error) => assert.include(err.message, 'tcdrain failed'));
+  });
+  it('canceled operations reject', () => {
+    const token = new CancelToken();
+    token.cancel();
+    assert.equal(token.canceled, true);
+    return tcdrainAsync(0, {cancel: token}).then(
+      () => assert.fail('should not resolve'),
+      (err: Error) => assert.include(err.message, 'tcdrain failed'));
+  });
+  it('tcsetattrAsync / writeToAsync apply settings', () => {
+    const old = new Termios(0);
+    const t = new Termios(old);
+    t.c_lflag &= ~native.LFLAGS.ECHO;
+    return t.writeToAsync(0, native.ACTION.TCSADRAIN, {timeout: 1000})
+      .then(() => {
+        assert.equal(new Termios(0).c_lflag & native.LFLAGS.ECHO, 0);
+        return tcsetattrAsync(0, native.ACTION.TCSANOW, (old as any)._data);
+      })
+      .then(() => assert.equal(new Termios(0).c_lflag, old.c_lflag));
+  });
+});
+
+describe('TtyReadStream', () => {
+  it('reads from pty slave with recycled ring slots', (done) => {
+    const fs = require('fs');
+    const [pair] = native.openpty();
+    // tiny ring to force slot reuse
+    const stream = new TtyReadStream(pair.slave, {chunkSize: 4, chunks: 2, zeroCopy: true});
+    const received: Buffer[] = [];
+    stream.on('data', (chunk: Buffer) => {
+      assert.isAtMost(chunk.length, 4);
+      received.push(Buffer.from(chunk));
+      if (Buffer.concat(received).toString().includes('world')) {
+        stream.destroy();
+        fs.closeSync(pair.slave);
+        fs.closeSync(pair.master);
+        assert.equal(Buffer.concat(received).toString(), 'hello\nworld\n');
+        done();
+      }
+    });
+    fs.writeSync(pair.master, 'hello\rworld\r');
+  });
+  it('pushes copies that outlive the ring slot by default', (done) => {
+    const fs = require('fs');
+    const [pair] = native.openpty();
+    const stream = new TtyReadStream(pair.master, {chunkSize: 4, chunks: 2});
+    // held without copying, like a buffering pipe() destination does
+    const received: Buffer[] = [];
+    stream.on('data', (chunk: Buffer) => {
+      received.push(chunk);
+      if (Buffer.concat(received).toString().includes('world')) {
+        stream.destroy();
+        fs.closeSync(pair.slave);
+        fs.closeSync(pair.master);
+        assert.equal(Buffer.concat(received).toString(), 'hello\r\nworld\r\n');
+        done();
+      }
+    });
+    fs.writeSync(pair.slave, 'hello\nworld\n');
+  });
+});
+
+describe('TtyReadStream packet mode', () => {
+  // TIOCPKT_IOCTL is only sent by Linux and needs EXTPROC
+  if (native.PKT.TIOCPKT_IOCTL === undefined || native.LFLAGS.EXTPROC === undefined) return;
+  it('splits data and reports slave termios changes', (done) => {
+    const fs = require('fs');
+    const [pair] = native.openpty();
+    const stream = new TtyReadStream(pair.master, {packet: true});
+    const t = new Termios(pair.slave);
+    stream.on('data', (chunk: Buffer) => {
+      assert.equal(chunk.toString(), 'hello');
+      // change slave settings, must show up as ioctl packet
+      t.c_lflag |= native.LFLAGS.EXTPROC!;
+      t.c_lflag &= ~native.LFLAGS.ECHO;
+      t.writeTo(pair.slave);
+    });
+    stream.on('ioctl', (termios: Termios) => {
+      assert.equal(termios.c_lflag & native.LFLAGS.ECHO, 0);
+      stream.destroy();
+      fs.closeSync(pair.slave);
+      fs.closeSync(pair.master);
+      done();
+    });
+    fs.writeSync(pair.slave, 'hello');
+  });
+});
+
+describe('TtyWriteStream', () => {
+  it('writes paced data to pty slave', (done) => {
+    const fs = require('fs');
+    const [pair] = native.openpty();
+    // tiny queue limit to force waiting on the output queue
+    const stream = new TtyWriteStream(pair.slave, {queueLimit: 16});
+    const reader = new TtyReadStream(pair.master);
+    const expected = 'x'.repeat(2000);
+    let received = '';
+    reader.on('data', (data: Buffer) => {
+      received += data.toString();
+      if (received.length >= expected.length) {
+        reader.destroy();
+        fs.closeSync(pair.slave);
+        fs.closeSync(pair.master);
+        assert.equal(received, expected);
+        done();
+      }
+    });
+    stream.end(expected);
+  });
+});
+
+describe('TtyMux', () => {
+  it('batches data of several ptys', done => {
+    const fs = require('fs');
+    const pairs = native.openpty({count: 3});
+    const mux = new TtyMux({chunkSize: 256, chunks: 4});
+    const received: {[fd: number]: string} = {};
+    mux.on('data', (batch: {fd: number, data: Buffer}[]) => {
+      for (const chunk of batch) {
+        received[chunk.fd] = (received[chunk.fd] || '') + chunk.data.toString();
+      }
+      if (pairs.every(pair => received[pair.master] === `hello ${pair.path}\r\n`)) {
+        mux.close();
+        for (const pair of pairs) {
+          fs.closeSync(pair.master);
+          fs.closeSync(pair.slave);
+        }
+        done();
+      }
+    });
+    for (const pair of pairs) {
+      mux.add(pair.master);
+      fs.writeSync(pair.slave, `hello ${pair.path}\n`);
+    }
+  });
+  it('holds back data for VMIN', done => {
+    const fs = require('fs');
+    const [pair] = native.openpty();
+    const t = new Termios(pair.master);
+    t.setraw();
+    t.c_cc[native.CC.VMIN] = 4;
+    const mux = new TtyMux();
+    mux.on('data', (batch: {fd: number, data: Buffer}[]) => {
+      assert.equal(batch[0].data.toString(), 'abcd');
+      mux.close();
+      fs.closeSync(pair.master);
+      fs.closeSync(pair.slave);
+      done();
+    });
+    mux.add(pair.master, t);
+    fs.writeSync(pair.slave, 'ab');
+    setTimeout(() => fs.writeSync(pair.slave, 'cd'), 50);
+  });
+  it('keeps reading with more VMIN ports than slots', done => {
+    const fs = require('fs');
+    const pairs = native.openpty({count: 6});
+    const mux = new TtyMux({chunkSize: 16, chunks: 4});
+    const received: {[fd: number]: string} = {};
+    mux.on('data', (batch: {fd: number, data: Buffer}[]) => {
+      for (const chunk of batch) {
+        received[chunk.fd] = (received[chunk.fd] || '') + chunk.data.toString();
+      }
+      if (pairs.every(pair => received[pair.master] === 'abcd')) {
+        mux.close();
+        // no-ops after close
+        mux.remove(pairs[0].master);
+        for (const pair of pairs) {
+          fs.closeSync(pair.master);
+          fs.closeSync(pair.slave);
+        }
+        done();
+      }
+    });
+    for (const pair of pairs) {
+      const t = new Termios(pair.slave);
+      t.setraw();
+      t.writeTo(pair.slave);
+      t.c_cc[native.CC.VMIN] = 4;
+      t.c_cc[native.CC.VTIME] = 1;
+      mux.add(pair.master, t);
+      fs.writeSync(pair.slave, 'ab');
+    }
+    setTimeout(() => pairs.forEach(pair => fs.writeSync(pair.slave, 'cd')), 50);
+  });
+  it('emits end', done => {
+    const fs = require('fs');
+    const [pair] = native.openpty();
+    const mux = new TtyMux();
+    mux.on('end', (fd: number) => {
+      assert.equal(fd, pair.master);
+      mux.close();
+      fs.closeSync(pair.master);
+      done();
+    });
+    mux.add(pair.master);
+    fs.closeSync(pair.slave);
+  });
+});
+
+describe('TtyFramer', () => {
+  it('charTime', () => {
+    const t = new Termios(null);
+    t.setSpeed(9600);
+    t.c_cflag |= native.CFLAGS.CS8;
+    assert.closeTo(TtyFramer.charTime(t), 10 * 1000000 / 9600, 0.001);
+    t.c_cflag |= native.CFLAGS.PARENB | native.CFLAGS.CSTOPB;
+    assert.closeTo(TtyFramer.charTime(t), 12 * 1000000 / 9600, 0.001);
+  });
+  it('splits frames at inter-byte gaps', done => {
+    const fs = require('fs');
+    const [pair] = native.openpty();
+    const t = new Termios(pair.slave);
+    t.setraw();
+    t.writeTo(pair.slave);
+    const framer = new TtyFramer(pair.master, {gap: 20000});
+    const frames: {data: Buffer, start: number, end: number, reason: number}[] = [];
+    framer.on('frame', frame => {
+      frames.push(frame);
+      if (frames.length === 2) {
+        assert.deepEqual(frames.map(f => f.data.toString()), ['abc', 'def']);
+        assert.equal(frames[0].reason, native.FRAME.GAP);
+        assert.isAtLeast(frames[1].start - frames[0].end, 20000);
+        framer.close();
+        fs.closeSync(pair.master);
+        fs.closeSync(pair.slave);
+        done();
+      }
+    });
+    fs.writeSync(pair.slave, 'abc');
+    setTimeout(() => fs.writeSync(pair.slave, 'def'), 100);
+  });
+  it('splits frames at delimiters and emits end', done => {
+    const fs = require('fs');
+    const [pair] = native.openpty();
+    const framer = new TtyFramer(pair.master, {delimiter: 10});
+    const frames: string[] = [];
+    framer.on('frame', frame => frames.push(frame.data.toString()));
+    framer.on('end', () => {
+      assert.deepEqual(frames, ['one\r\n', 'two\r\n', 'rest']);
+      fs.closeSync(pair.master);
+      done();
+    });
+    fs.writeSync(pair.slave, 'one\ntwo\nrest');
+    setTimeout(() => fs.closeSync(pair.slave), 50);
+  });
+  it('rejects oversized frame limits', () => {
+    const fs = require('fs');
+    const [pair] = native.openpty();
+    assert.throws(() => new TtyFramer(pair.master, {maxFrame: 0xffffffff}), 'invalid framing rules');
+    assert.throws(() => new TtyFramer(pair.master, {length: 0x20000000}), 'invalid framing rules');
+    fs.closeSync(pair.master);
+    fs.closeSync(pair.slave);
+  });
+});
+
+describe('TtyWriter', () => {
+  it('coalesces small writes', done => {
+    const fs = require('fs');
+    const [pair] = native.openpty();
+    const t = new Termios(pair.slave);
+    t.setraw();
+    t.writeTo(pair.slave);
+    const writer = new TtyWriter(pair.slave);
+    let expected = '';
+    for (let i = 0; i < 100; ++i) {
+      writer.write(`\x1b[${i}H`);
+      expected += `\x1b[${i}H`;
+    }
+    setImmediate(() => {
+      const data = Buffer.alloc(4096);
+      const length = fs.readSync(pair.master, data, 0, 4096, null);
+      assert.equal(data.toString('utf8', 0, length), expected);
+      writer.drain().then(() => {
+        assert.deepEqual(writer.stats, {writes: 100, bytes: expected.length, syscalls: 1, ratio: 100});
+        fs.closeSync(pair.master);
+        fs.closeSync(pair.slave);
+        done();
+      }, done);
+    });
+  });
+  it('native writev', () => {
+    const fs = require('fs');
+    const [pair] = native.openpty();
+    assert.equal(native.writev(pair.slave, [Buffer.from('ab'), Buffer.from('c')]), 3);
+    assert.equal(native.writev(-1, [Buffer.from('x')]), -native.ERRNO.EBADF);
+    assert.throws(() => native.writev(pair.slave, ['x' as any]), 'wrong buffer type');
+    fs.closeSync(pair.master);
+    fs.closeSync(pair.slave);
+  });
 });
 
 describe('terminal write/read test', () => {
@@ -245,6 +1046,95 @@ describe('terminal write/read test', () => {
   });
 });
 
+describe('shared Termios', () => {
+  it('objects attached to the same buffer share data', () => {
+    const t = Termios.createShared(0);
+    const other = Termios.fromShared(t.shared!);
+    assert.deepEqual(other.toJSON(), new Termios(0).toJSON());
+    other.update(o => {
+      o.c_lflag ^= native.LFLAGS.ECHO;
+      o.c_cc[native.CC.VMIN] = 7;
+    });
+    assert.equal(t.c_lflag, other.c_lflag);
+    assert.equal(t.c_cc[native.CC.VMIN], 7);
+  });
+  it('snapshot is a private copy', () => {
+    const t = Termios.createShared(0);
+    const snap = t.snapshot();
+    assert.equal(snap.shared, null);
+    assert.deepEqual(snap.toJSON(), t.toJSON());
+    t.c_iflag ^= native.IFLAGS.ICRNL;
+    assert.notEqual(snap.c_iflag, t.c_iflag);
+  });
+  it('loadFrom/writeTo', () => {
+    const t = Termios.createShared(null);
+    t.loadFrom(0);
+    assert.deepEqual(t.toJSON(), new Termios(0).toJSON());
+    t.writeTo(0, native.ACTION.TCSANOW);
+  });
+  it('rejects wrong buffers', () => {
+    assert.throws(() => Termios.fromShared(new SharedArrayBuffer(3)), 'wrong shared buffer size');
+  });
+  it('writeTo, loadFrom and snapshots within update', () => {
+    const fs = require('fs');
+    const [pair] = native.openpty();
+    const t = Termios.createShared(pair.slave);
+    t.update(x => {
+      x.setraw();
+      x.writeTo(pair.slave, native.ACTION.TCSANOW);
+      assert.equal(x.snapshot().c_lflag, x.c_lflag);
+      assert.include(x.toStty(), '-icanon');
+      x.loadFrom(pair.slave);
+    });
+    assert.equal(new Termios(pair.slave).c_lflag & native.LFLAGS.ICANON, 0);
+    assert.equal(t.c_lflag & native.LFLAGS.ICANON, 0);
+    fs.closeSync(pair.master);
+    fs.closeSync(pair.slave);
+  });
+  it('nested update runs within the outer one', () => {
+    const t = Termios.createShared(0);
+    const seq = new Int32Array(t.shared!, 0, 1);
+    const before = seq[0];
+    t.update(t => {
+      t.setraw();
+      t.c_cc[native.CC.VMIN] = 3;
+      assert.equal(seq[0] & 1, 1);
+    });
+    assert.equal(seq[0], before + 2);
+    assert.equal(t.c_lflag & native.LFLAGS.ECHO, 0);
+    assert.equal(t.c_cc[native.CC.VMIN], 3);
+    // writer state is restored after a throwing fn
+    assert.throws(() => t.update(() => { throw new Error('boom'); }), 'boom');
+    t.update(t => t.setcbreak());
+    assert.equal(seq[0] & 1, 0);
+  });
+  it('changes from workers show up', (done) => {
+    const { Worker } = require('worker_threads');
+    const t = Termios.createShared(null);
+    const worker = new Worker(`
+      const { Termios, native } = require('.');
+      const { workerData, parentPort } = require('worker_threads');
+      const t = Termios.fromShared(workerData);
+      for (let i = 0; i < 1000; ++i) {
+        t.update(t => { t.c_oflag += 1; t.c_cflag += 1; });
+      }
+      parentPort.postMessage('done');`
+      , {eval: true, workerData: t.shared});
+    let torn = 0;
+    const check = setInterval(() => {
+      const snap = t.snapshot();
+      if (snap.c_oflag !== snap.c_cflag) torn++;
+    }, 0);
+    worker.once('message', () => {
+      clearInterval(check);
+      assert.equal(torn, 0);
+      assert.equal(t.c_oflag, 1000);
+      assert.equal(t.c_cflag, 1000);
+      done();
+    });
+  });
+});
+
 describe('worker support', () => {
   it('multiple workers calling into native code', (done) => {
     const { Worker } = require('worker_threads');
@@ -1,10 +1,39 @@
 if (process.platform === 'win32')
     throw new Error('unsupported platform');
 
-import {ITermios, INative, IDataAccessor} from './interfaces';
+import {ITermios, INative, IAsyncOptions, ICancelToken, INativeTtyReader,
+    ITtyReadStreamOptions, ITtyWriteStreamOptions, IConstants, ISttyPatch, ISttyDescription,
+    IModeHandle, IParmrkError, IParmrkStats, INativeTtyMux, ITtyMuxOptions, ITtyMuxChunk,
+    ITtyWriterOptions, ITtyWriterStats, IWinsize, ISnapshotResult, INativeTtyFramer, ITtyFramerOptions,
+    IFrame} from './interfaces';
 import * as path from 'path';
+import * as fs from 'fs';
 import { endianness, platform } from 'os';
+import { Readable, Writable } from 'stream';
+import { EventEmitter } from 'events';
 export const native: INative = require(path.join('..', 'build', 'Release', 'termios.node'));
+
+/**
+ * Symbol tables and EXPLAIN generated at install time (see install.js).
+ *
+ * They replace the native objects, which otherwise get created on first access.
+ * The symbol groups are frozen, thus V8 can treat `s.ECHO | s.ICANON` as constant.
+ * Falls back to the native objects if the module is missing (e.g. manual rebuild).
+ */
+function loadConstants(): IConstants | null {
+    try {
+        return require(path.join('..', 'build', 'Release', 'constants.js'));
+    } catch (e) {
+        return null;
+    }
+}
+const constants = loadConstants();
+if (constants) {
+    for (const name of Object.keys(constants)) {
+        Object.defineProperty(native, name, {
+            value: (constants as any)[name], enumerable: true, configurable: true, writable: true});
+    }
+}
 const s = native.ALL_SYMBOLS;
 
 const ENDIAN = endianness();
@@ -47,65 +76,236 @@ if (T_MEM.c_lflag.width !== 4) throw new Error('unexpected c_lflag type');
 if (T_MEM.c_cc.elem_size !== 1) throw new Error('unexpected cc_t type');
 
 /**
- * Handle buffer data access.
- * We currently only support BE/LE with 4 bytes.
+ * Flag access.
+ *
+ * Termios data is held in a Buffer with its own ArrayBuffer, the flags
+ * are accessed through an Uint32Array on top of it. Typed arrays work in
+ * platform byte order, thus no endianness handling is needed and the
+ * accessors reduce to a single indexed load/store.
+ * The indices are derived once from EXPLAIN. On darwin (LE) the 8 byte flags
+ * are addressed by their lower 32 bits at the same offset.
  */
-const ACCESSORS: IDataAccessor  = {
-    BE: {
-        4: {
-            read: (b: Buffer, offset: number) => b.readUInt32BE(offset),
-            write: (b: Buffer, value: number, offset: number) => b.writeUInt32BE(value, offset)
-        }
-    },
-    LE: {
-        4: {
-            read: (b: Buffer, offset: number) => b.readUInt32LE(offset),
-            write: (b: Buffer, value: number, offset: number) => b.writeUInt32LE(value, offset)
-        }
+function flagIndex(name: string, offset: number): number {
+    if (offset & 3) throw new Error(`unexpected ${name} alignment`);
+    return offset >> 2;
+}
+const IFLAG = flagIndex('c_iflag', T_MEM.c_iflag.offset);
+const OFLAG = flagIndex('c_oflag', T_MEM.c_oflag.offset);
+const CFLAG = flagIndex('c_cflag', T_MEM.c_cflag.offset);
+const LFLAG = flagIndex('c_lflag', T_MEM.c_lflag.offset);
+const CC_START = T_MEM.c_cc.offset;
+const CC_END = T_MEM.c_cc.offset + T_MEM.c_cc.width;
+
+// shared slot layout: seqlock word, termios data at SHARED_HEADER
+const SHARED_HEADER = native.SHARED_HEADER;
+
+// backing buffers for the next Termios constructor call (see Termios._attach)
+let attachData: Buffer | null = null;
+let attachSlot: Buffer | null = null;
+
+// B* constant values, to tell them apart from bit rates in `Termios.setSpeed`
+const BAUD_VALUES: {[value: number]: boolean} = {};
+for (const name of Object.keys(native.BAUD)) {
+    BAUD_VALUES[(native.BAUD as any)[name]] = true;
+}
+
+/**
+ * Precompiled stty settings like 'raw -echo cs8 115200'.
+ *
+ * The spec gets parsed once into set and clear masks, c_cc overrides
+ * and a speed, applying the patch with `Termios.stty` is a few bit operations.
+ * Supported are single flags (`echo`, `-echo`, `cs7`, `tab3`), the combination
+ * settings `raw`, `-raw`/`cooked`, `cbreak`, `-cbreak`, `evenp`/`parity`,
+ * `oddp`, `nl` and their negations, control characters with a value
+ * (`intr ^C`, `erase ^?`, `eof undef`, `min 1`, `time 0`) and bit rates.
+ * Throws on unknown settings.
+ */
+export class SttyPatch implements ISttyPatch {
+    /** @internal compiled patch */
+    public readonly _data: Buffer;
+
+    constructor(public readonly spec: string) {
+        this._data = native.stty_compile(spec);
+        Object.freeze(this);
+    }
+}
+
+/**
+ * Token to cancel pending async operations.
+ *
+ * The token can be shared by several operations, `cancel` aborts all of them.
+ * Operations, that already finished, are not affected.
+ */
+export class CancelToken implements ICancelToken {
+    /** @internal flag polled by the native workers */
+    public readonly _flag = Buffer.alloc(1);
+
+    public get canceled(): boolean {
+        return !!this._flag[0];
+    }
+
+    public cancel(): void {
+        this._flag[0] = 1;
+    }
+}
+
+function asyncArgs(options?: IAsyncOptions): [number, Buffer | null] {
+    if (!options) {
+        return [0, null];
     }
+    const cancel = options.cancel;
+    if (cancel && !(cancel instanceof CancelToken)) {
+        throw new Error('cancel must be a CancelToken');
+    }
+    return [options.timeout || 0, cancel ? cancel._flag : null];
+}
+
+/**
+ * Wait until all output written to `fd` has been transmitted.
+ *
+ * Other than `native.tcdrain` this does not block the event loop,
+ * the wait runs on the libuv threadpool.
+ * Rejects with "tcdrain failed - ..." on error, timeout or cancelation.
+ */
+export function tcdrainAsync(fd: number, options?: IAsyncOptions): Promise<void> {
+    const [timeout, cancel] = asyncArgs(options);
+    return new Promise<void>((resolve, reject) => {
+        native.tcdrain_async(fd, timeout, cancel, err => err ? reject(err) : resolve());
+    });
+}
+
+/**
+ * Send a break on `fd` for `duration` (see `native.tcsendbreak`).
+ *
+ * A started break cannot be canceled, timeout and cancel
+ * only apply while the request is still queued.
+ */
+export function tcsendbreakAsync(fd: number, duration: number = 0, options?: IAsyncOptions): Promise<void> {
+    const [timeout, cancel] = asyncArgs(options);
+    return new Promise<void>((resolve, reject) => {
+        native.tcsendbreak_async(fd, duration, timeout, cancel, err => err ? reject(err) : resolve());
+    });
+}
+
+/**
+ * Write termios data held in `buffer` to `fd` without blocking the event loop.
+ *
+ * For `TCSADRAIN` and `TCSAFLUSH` the output queue is drained upfront,
+ * timeout and cancel apply to that drain phase.
+ * The buffer content is copied, later changes do not affect the pending call.
+ */
+export function tcsetattrAsync(fd: number, action: number, buffer: Buffer, options?: IAsyncOptions): Promise<void> {
+    const [timeout, cancel] = asyncArgs(options);
+    return new Promise<void>((resolve, reject) => {
+        native.tcsetattr_async(fd, action, buffer, timeout, cancel, err => err ? reject(err) : resolve());
+    });
+}
+
+// struct winsize - 4 unsigned shorts in native byte order
+const WINSIZE = Buffer.alloc(8);
+const WINSIZE_FIELDS = new Uint16Array(WINSIZE.buffer, WINSIZE.byteOffset, 4);
+
+/**
+ * Window size of `fd`. With `native.winsize_cache_enable(true)` repeated calls
+ * are served from the cache until the next SIGWINCH.
+ */
+export function getWinsize(fd: number): IWinsize {
+    native.getwinsize(fd, WINSIZE);
+    return {rows: WINSIZE_FIELDS[0], cols: WINSIZE_FIELDS[1], xpixel: WINSIZE_FIELDS[2], ypixel: WINSIZE_FIELDS[3]};
+}
+
+/** Set the window size of `fd` (e.g. a pty master). */
+export function setWinsize(fd: number, size: IWinsize): void {
+    native.setwinsize(fd, size.rows, size.cols, size.xpixel || 0, size.ypixel || 0);
+}
+
+/**
+ * Set the window sizes of many fds with a single native call.
+ * Returns 0 or the negative errno value per fd.
+ */
+export function setWinsizeMany(fds: number[], sizes: IWinsize[]): number[] {
+    if (fds.length !== sizes.length) {
+        throw new Error('fds and sizes must have the same length');
+    }
+    const buffer = Buffer.alloc(fds.length * 8);
+    const fields = new Uint16Array(buffer.buffer, buffer.byteOffset, fds.length * 4);
+    for (let i = 0; i < sizes.length; ++i) {
+        fields[i * 4] = sizes[i].rows;
+        fields[i * 4 + 1] = sizes[i].cols;
+        fields[i * 4 + 2] = sizes[i].xpixel || 0;
+        fields[i * 4 + 3] = sizes[i].ypixel || 0;
+    }
+    return native.setwinsize_many(fds, buffer);
+}
+
+/**
+ * Open (or create) a memory mapped snapshot store at `file`. While open, the state of every
+ * tty before its first change through this module gets recorded, `restoreAll(file)` reapplies
+ * them after a crash. Returns the record capacity of the store.
+ */
+export function openSnapshotStore(file: string, capacity: number = 64): number {
+    return native.snapshot_open(file, capacity);
+}
+
+/** Close the snapshot store. The file and its records are kept. */
+export function closeSnapshotStore(): void {
+    native.snapshot_close();
+}
+
+/**
+ * Reopen all devices recorded in the snapshot store at `file` and reapply
+ * their termios data and window sizes in one native pass.
+ */
+export function restoreAll(file: string, action: number = s.TCSANOW): ISnapshotResult[] {
+    return native.snapshot_restore_all(file, action);
 }
 
 /**
  * Class holding `struct termios` data.
  */
 export class Termios implements ITermios {
-    private _data = Buffer.from(Array(T_SIZE));
+    private _data: Buffer;
+    private _flags: Uint32Array;
+    private _cc: Buffer;
+    private _slot: Buffer | null;
+    private _seq: Int32Array | null;
+    private _depth: number;
 
     /** Getter/setter for input flags. */
     public get c_iflag(): number {
-        return ACCESSORS[ENDIAN][4].read(this._data, T_MEM.c_iflag.offset);
+        return this._flags[IFLAG];
     }
     public set c_iflag(value: number) {
-        ACCESSORS[ENDIAN][4].write(this._data, value, T_MEM.c_iflag.offset);
+        this._flags[IFLAG] = value;
     }
 
     /** Getter/setter for output flags. */
     public get c_oflag(): number {
-        return ACCESSORS[ENDIAN][4].read(this._data, T_MEM.c_oflag.offset);
+        return this._flags[OFLAG];
     }
     public set c_oflag(value: number) {
-        ACCESSORS[ENDIAN][4].write(this._data, value, T_MEM.c_oflag.offset);
+        this._flags[OFLAG] = value;
     }
 
     /** Getter/setter for control flags. */
     public get c_cflag(): number {
-        return ACCESSORS[ENDIAN][4].read(this._data, T_MEM.c_cflag.offset);
+        return this._flags[CFLAG];
     }
     public set c_cflag(value: number) {
-        ACCESSORS[ENDIAN][4].write(this._data, value, T_MEM.c_cflag.offset);
+        this._flags[CFLAG] = value;
     }
 
     /** Getter/setter for local flags. */
     public get c_lflag(): number {
-        return ACCESSORS[ENDIAN][4].read(this._data, T_MEM.c_lflag.offset);
+        return this._flags[LFLAG];
     }
     public set c_lflag(value: number) {
-        ACCESSORS[ENDIAN][4].write(this._data, value, T_MEM.c_lflag.offset);
+        this._flags[LFLAG] = value;
     }
 
     /** Buffer to access control code settings. */
     public get c_cc(): Buffer {
-        return this._data.subarray(T_MEM.c_cc.offset, T_MEM.c_cc.offset + T_MEM.c_cc.width);
+        return this._cc;
     }
 
     /**
@@ -124,30 +324,159 @@ export class Termios implements ITermios {
         if (!(this instanceof Termios)) {
             return new Termios(from);
         }
+        // all instances get the same fields in the same order (same hidden class)
+        const data = attachData || Buffer.alloc(T_SIZE);
+        this._data = data;
+        this._flags = new Uint32Array(data.buffer, data.byteOffset, T_SIZE >> 2);
+        this._cc = data.subarray(CC_START, CC_END);
+        this._slot = attachSlot;
+        this._seq = attachSlot ? new Int32Array(attachSlot.buffer, attachSlot.byteOffset, 1) : null;
+        this._depth = 0;
+        if (attachData) {
+            attachData = null;
+            attachSlot = null;
+        } else {
+            this._init(from);
+        }
+    }
+
+    /** @internal Termios object on existing memory, `slot` holds the seqlock word of shared data. */
+    private static _attach(data: Buffer, slot: Buffer | null): Termios {
+        attachData = data;
+        attachSlot = slot;
+        return new Termios();
+    }
+
+    /** @internal Fill data from a constructor argument (see constructor). */
+    public _init(from?: number | ITermios | null): void {
         if (typeof from === 'number') {
             this.loadFrom(from);
         } else if (from instanceof Termios) {
-            this._data = Buffer.from(from._data);
+            // within its own update the data of a shared object is consistent already
+            if (from._slot && !from._depth) {
+                native.shared_snapshot(from._slot, this._data);
+            } else {
+                from._data.copy(this._data);
+            }
         } else if (from === undefined) {
             if (!native.load_ttydefaults(this._data)) {
                 console.warn('Termios: Loading ttydefaults.h not supported on this platform.');
             }
-        } else if (from !== null) {
+        } else if (from === null) {
             // null explicitly loads empty termios data
+            this._data.fill(0);
+        } else {
             // anything else throws an error
             throw new Error('unsupported from value');
         }
-        // make termios primitives enumerable
-        for(const property of ['c_iflag', 'c_oflag', 'c_cflag', 'c_lflag', 'c_cc']) {
-			const desc = Object.getOwnPropertyDescriptor(Termios.prototype, property);
-			const modified = Object.assign(desc, {enumerable: true});
-			Object.defineProperty(this, property, modified);
-		}
+    }
+
+    /**
+     * @internal Consistent termios data for native calls.
+     * Shared objects return a snapshot (their data directly within `update`),
+     * private ones their own buffer. Do not alter the returned buffer.
+     */
+    public _consistentData(): Buffer {
+        return (this._slot && !this._depth) ? this.snapshot()._data : this._data;
+    }
+
+    /** @internal Termios object viewing `data` (a slot of a TermiosPool slab). */
+    public static _view(data: Buffer): Termios {
+        return Termios._attach(data, null);
+    }
+
+    /**
+     * Create a Termios object living in a SharedArrayBuffer.
+     *
+     * `from` is handled as in the constructor. Post `termios.shared` to other
+     * workers and attach there with `Termios.fromShared`, all of them work
+     * on the same data then. `loadFrom` and `writeTo` on shared objects are
+     * serialized per fd across workers and never see a torn struct.
+     * Single flag accesses are plain 32 bit loads/stores, that bypass the
+     * seqlock: outside of `update` a concurrent reader may see them together
+     * with half of another worker's update. Wrap changes into `update`,
+     * if they have to be seen as a whole.
+     */
+    public static createShared(from?: number | ITermios | null): Termios {
+        const initial = new Termios(from);
+        const termios = Termios.fromShared(new SharedArrayBuffer(SHARED_HEADER + T_SIZE));
+        initial._data.copy(termios._data);
+        return termios;
+    }
+
+    /** Attach to termios data in a SharedArrayBuffer (see `createShared`). */
+    public static fromShared(buffer: SharedArrayBuffer): Termios {
+        if (buffer.byteLength !== SHARED_HEADER + T_SIZE) {
+            throw new Error('wrong shared buffer size');
+        }
+        const slot = Buffer.from(buffer as any as ArrayBuffer);
+        return Termios._attach(slot.subarray(SHARED_HEADER), slot);
+    }
+
+    /** SharedArrayBuffer holding the data, null for private objects. */
+    public get shared(): SharedArrayBuffer | null {
+        return this._seq ? this._seq.buffer as SharedArrayBuffer : null;
+    }
+
+    /**
+     * Apply several changes at once.
+     *
+     * For shared objects `fn` runs as writer of the seqlock, thus other
+     * workers see either none or all of the changes in `loadFrom`, `writeTo`
+     * and snapshots. Keep `fn` short, other writers spin meanwhile.
+     * Nested calls on the same object (e.g. `setraw` within `fn`) run
+     * as part of the outer update, as do `loadFrom`, `writeTo` and
+     * snapshots of the object.
+     */
+    public update(fn: (termios: Termios) => void): void {
+        const seq = this._seq;
+        if (!seq || this._depth) {
+            fn(this);
+            return;
+        }
+        for (;;) {
+            const current = Atomics.load(seq, 0);
+            if (!(current & 1) && Atomics.compareExchange(seq, 0, current, current + 1) === current) {
+                break;
+            }
+        }
+        this._depth++;
+        try {
+            fn(this);
+        } finally {
+            this._depth--;
+            Atomics.add(seq, 0, 1);
+        }
+    }
+
+    /** Private copy of the current data (consistent copy for shared objects). */
+    public snapshot(): Termios {
+        return new Termios(this);
+    }
+
+    /**
+     * Serialize termios primitives (accessors live on the prototype).
+     * Other than before the accessors moved to the prototype, the raw
+     * struct data (`_data`) is not part of the output, use `c_*` to
+     * restore settings from JSON.
+     */
+    public toJSON(): {[key: string]: number | Buffer} {
+        return {
+            c_iflag: this.c_iflag,
+            c_oflag: this.c_oflag,
+            c_cflag: this.c_cflag,
+            c_lflag: this.c_lflag,
+            c_cc: this.c_cc
+        };
     }
 
     /** Load termios data from file descriptor `fd`. */
     public loadFrom(fd: number): void {
-        native.tcgetattr(fd, this._data);
+        if (this._slot) {
+            native.shared_load(fd, this._slot, this._depth > 0);
+        } else {
+            native.tcgetattr(fd, this._data);
+        }
     }
 
     /**
@@ -157,7 +486,58 @@ export class Termios implements ITermios {
      * (default: `TCSAFLUSH`).
      */
     public writeTo(fd: number, action: number = s.TCSAFLUSH): void {
-        native.tcsetattr(fd, action, this._data);
+        if (this._slot) {
+            native.shared_store(fd, action, this._slot, this._depth > 0);
+        } else {
+            native.tcsetattr(fd, action, this._data);
+        }
+    }
+
+    /**
+     * Async version of `writeTo`, see `tcsetattrAsync`.
+     *
+     * Returns a promise, that resolves once the settings were applied.
+     */
+    public writeToAsync(fd: number, action: number = s.TCSAFLUSH, options?: IAsyncOptions): Promise<void> {
+        return tcsetattrAsync(fd, action, this._consistentData(), options);
+    }
+
+    /**
+     * Load termios data for many file descriptors with a single native call.
+     *
+     * Loads data of `fds[i]` into `termios[i]`. Does not throw on failing fds,
+     * instead returns an array of 0 or negative errno values.
+     * On failure the corresponding termios object is left untouched.
+     */
+    public static loadMany(fds: number[], termios: Termios[]): number[] {
+        if (fds.length !== termios.length) {
+            throw new Error('fds and termios length mismatch');
+        }
+        const buffer = Buffer.alloc(T_SIZE * fds.length);
+        const result = native.tcgetattr_many(fds, buffer);
+        for (let i = 0; i < fds.length; ++i) {
+            if (!result[i]) {
+                termios[i].update(t => buffer.copy(t._data, 0, i * T_SIZE, (i + 1) * T_SIZE));
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Write termios data to many file descriptors with a single native call.
+     *
+     * Writes `termios[i]` to `fds[i]`. Does not throw on failing fds,
+     * instead returns an array of 0 or negative errno values.
+     */
+    public static writeMany(fds: number[], termios: Termios[], action: number = s.TCSAFLUSH): number[] {
+        if (fds.length !== termios.length) {
+            throw new Error('fds and termios length mismatch');
+        }
+        const buffer = Buffer.allocUnsafe(T_SIZE * fds.length);
+        for (let i = 0; i < fds.length; ++i) {
+            termios[i]._consistentData().copy(buffer, i * T_SIZE);
+        }
+        return native.tcsetattr_many(fds, action, buffer);
     }
 
     /** Return input channel baud rate setting as in `native.BAUD`. */
@@ -191,31 +571,37 @@ export class Termios implements ITermios {
     /**
      * Set input and output channel baud rate.
      *
-     * `speed` should be one of the baudrates in `native.BAUD`.
+     * `speed` is either one of the baudrates in `native.BAUD` or a bit rate
+     * as integer, e.g. 115200. Bit rates without a `native.BAUD` constant
+     * (e.g. 250000 for DMX) are supported on Linux (`native.ARBITRARY_BAUD`),
+     * elsewhere they throw.
      * @note Normally the input and output speed are entangled by the system,
      * thus setting one would also change the other one.
+     * @note On Linux the values of `B0` to `B38400` and the higher `B*` constants
+     * are small numbers, that never clash with a real bit rate.
      */
     public setSpeed(speed: number): void {
-        native.cfsetispeed(this._data, speed);
-        native.cfsetospeed(this._data, speed);
+        if (BAUD_VALUES[speed]) {
+            native.cfsetispeed(this._data, speed);
+            native.cfsetospeed(this._data, speed);
+        } else {
+            native.cfsetrate(this._data, speed);
+        }
+    }
+
+    /** Return output channel speed as bit rate, e.g. 115200 (-1 if unknown). */
+    public getRate(): number {
+        return native.cfgetrate(this._data);
     }
 
     /** Convenient method to set termios data to raw mode (flags taken from Python). */
     public setraw(): void {
-        this.c_iflag &= ~(s.BRKINT | s.ICRNL | s.INPCK | s.ISTRIP | s.IXON);
-        this.c_oflag &= ~s.OPOST;
-        this.c_cflag &= ~(s.CSIZE | s.PARENB);
-        this.c_cflag |= s.CS8;
-        this.c_lflag &= ~(s.ECHO | s.ICANON | s.IEXTEN | s.ISIG);
-        this.c_cc[s.VMIN] = 1;
-        this.c_cc[s.VTIME] = 0;
+        this.update(t => native.apply_mode(t._data, native.MODE.RAW));
     }
 
     /** Convenient method to set termios data to cbreak mode (flags taken from Python). */
     public setcbreak(): void {
-        this.c_lflag &= ~(s.ECHO | s.ICANON);
-        this.c_cc[s.VMIN] = 1;
-        this.c_cc[s.VTIME] = 0;
+        this.update(t => native.apply_mode(t._data, native.MODE.CBREAK));
     }
 
     /**
@@ -225,15 +611,740 @@ export class Termios implements ITermios {
      * like job control (BRKINT), NL/CR rewrites and the line editor
      * (ICANON) with echoing (ECHO). This might differ from your
      * expectations, as systems may use slightly different settings.
+     * `c_cc` is left untouched, there is no portable set of defaults.
+     * Where VMIN/VTIME share their slots with VEOF/VEOL (e.g. Solaris),
+     * `setraw` overwrote those, restore the previous settings instead
+     * (see `enterRaw`).
      */
     public setcooked(): void {
-        this.c_iflag = s.BRKINT | s.ICRNL | s.INPCK | s.ISTRIP | s.IXON | s.IGNPAR;
-        this.c_oflag = s.OPOST | s.ONLCR;
-        this.c_cflag |= s.CS8;
-        this.c_lflag = s.ECHOKE | s.ECHOCTL | s.ECHOE | s.ECHO | s.ICANON | s.IEXTEN | s.ISIG;
-        if (s.ECHOK) {
-            this.c_lflag |= s.ECHOK;
-        }
-        // FIXME: set c_cc values?
+        this.update(t => native.apply_mode(t._data, native.MODE.COOKED));
+    }
+
+    /**
+     * Switch `fd` to raw mode with a single native call
+     * (tcgetattr, setraw and tcsetattr).
+     * Returns a handle to restore the previous settings.
+     */
+    public static enterRaw(fd: number, action: number = s.TCSAFLUSH): IModeHandle {
+        return Termios.enterMode(fd, native.MODE.RAW, action);
+    }
+
+    /** Like `enterRaw` for any preset in `native.MODE` (except SNAPSHOT). */
+    public static enterMode(fd: number, preset: number, action: number = s.TCSAFLUSH): IModeHandle {
+        if (preset === native.MODE.SNAPSHOT) {
+            throw new Error('enterMode does not support MODE.SNAPSHOT, use writeTo to apply termios data');
+        }
+        const previous = new Termios(null);
+        native.setmode(fd, preset, action, previous._data);
+        return {
+            fd,
+            previous,
+            restore: (restoreAction: number = s.TCSAFLUSH) => {
+                native.setmode(fd, native.MODE.SNAPSHOT, restoreAction, null, previous._data);
+            }
+        };
+    }
+
+    /**
+     * Apply stty settings, either as spec string or precompiled `SttyPatch`.
+     * For repeated use of the same settings precompile them once.
+     * Shared objects get updated as one seqlock write.
+     */
+    public stty(spec: string | SttyPatch): void {
+        const patch = (spec instanceof SttyPatch) ? spec : new SttyPatch(spec);
+        this.update(t => native.stty_apply(patch._data, t._data));
+    }
+
+    /** Termios data in stty notation. */
+    public describe(): ISttyDescription {
+        return native.stty_describe(this._consistentData());
+    }
+
+    /** Termios data as text similar to `stty -a`. */
+    public toStty(): string {
+        return native.stty_describe(this._consistentData(), true);
+    }
+}
+
+
+// make termios primitives enumerable on the prototype,
+// which keeps the instances free of own accessor properties
+for (const property of ['c_iflag', 'c_oflag', 'c_cflag', 'c_lflag', 'c_cc']) {
+    const desc = Object.getOwnPropertyDescriptor(Termios.prototype, property);
+    Object.defineProperty(Termios.prototype, property, Object.assign(desc, {enumerable: true}));
+}
+
+/**
+ * Fixed number of Termios objects living in one slab buffer.
+ *
+ * Slot `i` holds its termios data at `i * EXPLAIN.size` of `slab`. `acquire`
+ * hands out the Termios view of a free slot, `release` returns it for reuse,
+ * thus views are created once per slot and no further buffers get allocated.
+ * `loadAll` and `writeAll` pass the slab to the native batch functions as it is.
+ */
+export class TermiosPool {
+    public readonly slab: Buffer;
+    private _views: Termios[] = [];
+    private _index = new Map<Termios, number>();
+    private _free: number[] = [];
+    private _used: Uint8Array;
+
+    constructor(public readonly capacity: number) {
+        if (!(capacity > 0)) {
+            throw new Error('capacity must be positive');
+        }
+        this.slab = Buffer.alloc(capacity * T_SIZE);
+        this._used = new Uint8Array(capacity);
+        for (let i = capacity - 1; i >= 0; --i) {
+            this._free.push(i);
+        }
+    }
+
+    /** Number of acquired Termios objects. */
+    public get size(): number {
+        return this.capacity - this._free.length;
+    }
+
+    /**
+     * Termios object of a free slot, initialized from `from` as in the Termios constructor.
+     * Throws if the pool is exhausted.
+     */
+    public acquire(from?: number | ITermios | null): Termios {
+        const index = this._free.pop();
+        if (index === undefined) {
+            throw new Error('pool exhausted');
+        }
+        let termios = this._views[index];
+        if (!termios) {
+            termios = Termios._view(this.slab.subarray(index * T_SIZE, (index + 1) * T_SIZE));
+            this._views[index] = termios;
+            this._index.set(termios, index);
+        }
+        try {
+            termios._init(from);
+        } catch (e) {
+            this._free.push(index);
+            throw e;
+        }
+        this._used[index] = 1;
+        return termios;
+    }
+
+    /** Return an acquired Termios object to the pool, it must not be used afterwards. */
+    public release(termios: Termios): void {
+        const index = this.indexOf(termios);
+        if (index === -1 || !this._used[index]) {
+            throw new Error('termios not acquired from this pool');
+        }
+        this._used[index] = 0;
+        this._free.push(index);
+    }
+
+    /** Slot of an acquired Termios object, -1 if it does not belong to the pool. */
+    public indexOf(termios: Termios): number {
+        const index = this._index.get(termios);
+        return index === undefined ? -1 : index;
+    }
+
+    /**
+     * Load termios data of `fds[i]` into slot `i` with a single native call.
+     * Returns 0 or the negative errno value per slot, negative fds skip their slot (-EBADF).
+     */
+    public loadAll(fds: number[]): number[] {
+        return native.tcgetattr_many(fds, this._prefix(fds.length));
+    }
+
+    /**
+     * Write slot `i` to `fds[i]` with a single native call.
+     * Returns 0 or the negative errno value per slot, negative fds skip their slot (-EBADF).
+     */
+    public writeAll(fds: number[], action: number = s.TCSAFLUSH): number[] {
+        return native.tcsetattr_many(fds, action, this._prefix(fds.length));
+    }
+
+    private _prefix(length: number): Buffer {
+        if (length > this.capacity) {
+            throw new Error('more fds than pool slots');
+        }
+        return length === this.capacity ? this.slab : this.slab.subarray(0, length * T_SIZE);
+    }
+}
+
+/**
+ * Line discipline translations for data, that does not pass a kernel tty
+ * (e.g. terminals tunneled over a socket).
+ *
+ * Applies the output (`c_oflag`: OPOST, ONLCR, OCRNL, ONOCR, ONLRET, OLCUC)
+ * or input rules (`c_iflag`: ISTRIP, IUCLC, IGNCR, ICRNL, INLCR) of `termios`
+ * as currently set. The output column is carried across chunks.
+ */
+export class Translator {
+    private _state = Buffer.alloc(4);
+
+    constructor(public termios: Termios, public readonly direction: number = native.TRANSLATE.OUTPUT) {}
+
+    /** Translate `chunk` into a new buffer. */
+    public translate(chunk: Buffer): Buffer {
+        const factor = this.direction === native.TRANSLATE.OUTPUT ? 2 : 1;
+        const output = Buffer.allocUnsafe(chunk.length * factor);
+        return output.subarray(0, this.translateInto(chunk, output));
+    }
+
+    /**
+     * Translate `chunk` into `output`, returns the number of bytes written.
+     * `output` must hold twice the length of `chunk` for output translations.
+     */
+    public translateInto(chunk: Buffer, output: Buffer): number {
+        return native.translate(this.termios._consistentData(), this.direction, chunk, output, this._state);
+    }
+
+    /** Reset the output column (e.g. after a reconnect). */
+    public reset(): void {
+        this._state.fill(0);
+    }
+}
+
+/**
+ * Streaming decoder for input marked with PARMRK (and INPCK).
+ *
+ * The kernel marks parity/framing errors as `\377 \0 X`, breaks as `\377 \0 \0`
+ * (indistinguishable from an error on a NUL byte) and escapes a literal `\377`
+ * as `\377 \377`. `decode` returns the clean payload - the chunk itself
+ * if it contains no markers - and reports the errors of the chunk in `errors`.
+ * Markers split across chunks are handled. Input passes unchanged,
+ * if `termios` has PARMRK unset or IGNPAR set.
+ */
+export class ParmrkDecoder {
+    private _state = new Uint32Array(native.PARMRK.STATE_SIZE);
+    private _errors = new Uint32Array(3 * 64);
+    /** Errors of the last decoded chunk. */
+    public errors: IParmrkError[] = [];
+
+    constructor(public termios: Termios) {}
+
+    public decode(chunk: Buffer): Buffer {
+        // a chunk can hold at most one marker per 3 bytes (+1 split from the last chunk)
+        const records = Math.floor(chunk.length / 3) + 1;
+        if (this._errors.length < records * 3) {
+            this._errors = new Uint32Array(records * 3);
+        }
+        // +1 for a stray \377 carried over from the last chunk
+        const output = Buffer.allocUnsafe(chunk.length + 1);
+        const length = native.parmrk_decode(this.termios._consistentData(), chunk, output, this._state, this._errors);
+        const count = this._state[1];
+        const errors = this._errors;
+        this.errors = [];
+        for (let i = 0; i < count * 3; i += 3) {
+            this.errors.push({offset: errors[i], kind: errors[i + 1], value: errors[i + 2]});
+        }
+        return length === -1 ? chunk : output.subarray(0, length);
+    }
+
+    /** Counters since creation. */
+    public get stats(): IParmrkStats {
+        const state = this._state;
+        return {bytes: state[3], errors: state[4], breaks: state[5], escaped: state[6], dropped: state[2]};
+    }
+}
+
+/**
+ * Readable stream for a tty file descriptor, backed by the native `TtyReader`.
+ *
+ * Data gets read into a preallocated ring of `chunks` slots. By default
+ * every chunk is copied out of the ring before it is pushed, thus chunks
+ * can be held as long as needed (e.g. by a `pipe()` destination).
+ * With `zeroCopy` set, chunks are pushed as views into the ring and a slot
+ * gets recycled once the stream buffer ran empty, thus a chunk is only valid
+ * within the 'data' handler (paused mode: until the next `read()` call).
+ * Do not `pipe()` a zero-copy stream into a Writable, that buffers chunks.
+ *
+ * With `packet` set the fd (a pty master) is switched to packet mode.
+ * Control bytes are split off the data and reported as 'packet' event
+ * and as 'flushread', 'flushwrite', 'stop', 'start', 'nostop', 'dostop'
+ * and 'ioctl' events. On 'ioctl' (slave termios changed, needs EXTPROC
+ * on Linux) `termios` gets reloaded before the event is emitted.
+ *
+ * @note The fd is switched to nonblocking mode.
+ */
+export class TtyReadStream extends Readable {
+    public readonly fd: number;
+    /** Termios of the pty, updated on 'ioctl' events in packet mode. */
+    public termios: Termios | null = null;
+    private _reader: INativeTtyReader;
+    private _slab: Buffer;
+    private _chunkSize: number;
+    private _offset: number;
+    private _zeroCopy: boolean;
+    private _pending: number[] = [];
+
+    constructor(fd: number, options?: ITtyReadStreamOptions) {
+        super();
+        const opts = options || {};
+        this.fd = fd;
+        this._chunkSize = opts.chunkSize || 4096;
+        this._offset = opts.packet ? 1 : 0;
+        this._zeroCopy = !!opts.zeroCopy;
+        this._slab = Buffer.allocUnsafeSlow(this._chunkSize * (opts.chunks || 16));
+        if (opts.packet) {
+            native.packet_mode(fd, true);
+            this.termios = new Termios(fd);
+        }
+        this._reader = new native.TtyReader(fd, this._slab, this._chunkSize,
+            (err, slot, length, control) => this._onRead(err, slot, length, control), !!opts.packet);
+    }
+
+    public _read(size: number): void {
+        this._recycle();
+        this._reader.start();
+    }
+
+    public _destroy(err: Error | null, callback: (error?: Error | null) => void): void {
+        this._reader.close();
+        callback(err);
+    }
+
+    private _onRead(err: Error | null, slot: number, length: number, control: number): void {
+        if (err) {
+            this.destroy(err);
+            return;
+        }
+        if (slot === -1 && control) {
+            this._onControl(control);
+            return;
+        }
+        if (slot === -1) {
+            // EOF
+            this._reader.close();
+            this.push(null);
+            return;
+        }
+        const start = slot * this._chunkSize + this._offset;
+        let more: boolean;
+        if (this._zeroCopy) {
+            this._pending.push(slot);
+            more = this.push(this._slab.subarray(start, start + length));
+            this._recycle();
+        } else {
+            const chunk = Buffer.allocUnsafe(length);
+            this._slab.copy(chunk, 0, start, start + length);
+            this._reader.release(slot);
+            more = this.push(chunk);
+        }
+        if (!more) {
+            this._reader.stop();
+        }
+    }
+
+    private _onControl(control: number): void {
+        const PKT = native.PKT;
+        this.emit('packet', control);
+        if (control & PKT.TIOCPKT_FLUSHREAD) this.emit('flushread');
+        if (control & PKT.TIOCPKT_FLUSHWRITE) this.emit('flushwrite');
+        if (control & PKT.TIOCPKT_STOP) this.emit('stop');
+        if (control & PKT.TIOCPKT_START) this.emit('start');
+        if (control & PKT.TIOCPKT_NOSTOP) this.emit('nostop');
+        if (control & PKT.TIOCPKT_DOSTOP) this.emit('dostop');
+        if (PKT.TIOCPKT_IOCTL && control & PKT.TIOCPKT_IOCTL) {
+            try {
+                this.termios!.loadFrom(this.fd);
+            } catch (e) {
+                this.destroy(e);
+                return;
+            }
+            this.emit('ioctl', this.termios);
+        }
+    }
+
+    /** Return slots to the ring once nothing is buffered anymore. */
+    private _recycle(): void {
+        if (this.readableLength) {
+            return;
+        }
+        for (const slot of this._pending) {
+            this._reader.release(slot);
+        }
+        this._pending.length = 0;
+    }
+}
+
+
+/**
+ * Writable stream for a tty file descriptor, paced by the output queue depth.
+ *
+ * Other than waiting for `tcdrain` between writes, the stream only waits
+ * while more than `queueLimit` bytes are pending in the output queue (TIOCOUTQ),
+ * thus the line stays busy without piling up data in the kernel.
+ * The wait time gets estimated from the line speed (~10 bits per byte),
+ * the data itself is written on the libuv threadpool.
+ *
+ * The speed is read once during construction, call `updateRate` after
+ * changing the line speed.
+ */
+export class TtyWriteStream extends Writable {
+    public readonly fd: number;
+    private _queueLimit: number;
+    private _maxDelay: number;
+    private _bytesPerMs: number = 0;
+
+    constructor(fd: number, options?: ITtyWriteStreamOptions) {
+        const opts = options || {};
+        super({highWaterMark: opts.highWaterMark});
+        this.fd = fd;
+        this._queueLimit = opts.queueLimit === undefined ? 256 : opts.queueLimit;
+        this._maxDelay = opts.maxDelay || 50;
+        this.updateRate();
+    }
+
+    /** Re-read the line speed used to estimate wait times. */
+    public updateRate(): void {
+        const rate = new Termios(this.fd).getRate();
+        this._bytesPerMs = (rate > 0 ? rate : 9600) / 10000;
+    }
+
+    public _write(chunk: Buffer, encoding: string, callback: (error?: Error | null) => void): void {
+        this._writeChunk(chunk, 0, callback);
+    }
+
+    private _writeChunk(chunk: Buffer, offset: number, callback: (error?: Error | null) => void): void {
+        let pending: number;
+        try {
+            pending = native.outq(this.fd);
+        } catch (e) {
+            callback(e);
+            return;
+        }
+        if (pending > this._queueLimit) {
+            this._wait(pending - this._queueLimit, () => this._writeChunk(chunk, offset, callback));
+            return;
+        }
+        fs.write(this.fd, chunk, offset, chunk.length - offset, null, (err, written) => {
+            if (err) {
+                // nonblocking fd with a full queue
+                if ((err as NodeJS.ErrnoException).code === 'EAGAIN') {
+                    this._wait(this._queueLimit || 1, () => this._writeChunk(chunk, offset, callback));
+                    return;
+                }
+                callback(err);
+                return;
+            }
+            if (offset + written < chunk.length) {
+                this._writeChunk(chunk, offset + written, callback);
+                return;
+            }
+            callback();
+        });
+    }
+
+    /** Wait roughly the time needed to transmit `bytes`. */
+    private _wait(bytes: number, callback: () => void): void {
+        setTimeout(callback, Math.max(1, Math.min(this._maxDelay, bytes / this._bytesPerMs)));
+    }
+}
+
+/**
+ * Reads many tty fds with a single native thread (epoll on Linux, poll elsewhere)
+ * and a single event loop handle.
+ *
+ * Data of all fds arrived within an event loop turn is emitted as one 'data'
+ * batch of `{fd, data}` entries. `data` is a zero-copy view into a slab shared
+ * by all fds, the slots get recycled after the handler returned, thus copy
+ * data you want to keep. An fd at EOF (or EIO) emits 'end', read errors emit
+ * 'error' with the fd as second argument, the fd is removed in both cases.
+ *
+ * Data is held back per fd according to VMIN / VTIME of the termios settings
+ * given to `add` (loaded from the fd if omitted, no hold back in canonical mode).
+ *
+ * @note The fds are switched to nonblocking mode.
+ */
+export class TtyMux extends EventEmitter {
+    public readonly chunkSize: number;
+    private _mux: INativeTtyMux;
+    private _slab: Buffer;
+
+    constructor(options?: ITtyMuxOptions) {
+        super();
+        const opts = options || {};
+        this.chunkSize = opts.chunkSize || 4096;
+        this._slab = Buffer.allocUnsafeSlow(this.chunkSize * (opts.chunks || 64));
+        this._mux = new native.TtyMux(this._slab, this.chunkSize, records => this._onRecords(records));
+    }
+
+    /** Watch `fd`, `termios` provides VMIN / VTIME. */
+    public add(fd: number, termios?: Termios): void {
+        const t = termios || new Termios(fd);
+        if (t.c_lflag & s.ICANON) {
+            this._mux.add(fd);
+        } else {
+            this._mux.add(fd, t.c_cc[s.VMIN], t.c_cc[s.VTIME]);
+        }
+    }
+
+    /** Stop watching `fd`, data held back gets emitted. */
+    public remove(fd: number): void {
+        this._mux.remove(fd);
+    }
+
+    /** Stop the native thread, no further events are emitted. */
+    public close(): void {
+        this._mux.close();
+    }
+
+    private _onRecords(records: Int32Array): void {
+        const batch: ITtyMuxChunk[] = [];
+        for (let i = 0; i < records.length; i += 3) {
+            const fd = records[i];
+            const slot = records[i + 1];
+            const length = records[i + 2];
+            if (slot !== -1) {
+                const start = slot * this.chunkSize;
+                batch.push({fd, data: this._slab.subarray(start, start + length)});
+            } else if (length) {
+                const message = native.raw.strerror(-length);
+                process.nextTick(() => this.emit('error', new Error(`read failed - ${message}`), fd));
+            } else {
+                process.nextTick(() => this.emit('end', fd));
+            }
+        }
+        try {
+            if (batch.length) {
+                this.emit('data', batch);
+            }
+        } finally {
+            for (let i = 0; i < records.length; i += 3) {
+                if (records[i + 1] !== -1) {
+                    this._mux.release(records[i + 1]);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Splits the input of a tty into frames with microsecond precise inter-byte gaps,
+ * e.g. Modbus RTU frames separated by 3.5 character times of silence.
+ *
+ * Bytes are read and timestamped (CLOCK_MONOTONIC, also used by `process.hrtime`
+ * on Linux) by a native thread. Emits 'frame' (IFrame) per frame, 'end' at EOF and
+ * 'error' on read errors. Note that the timestamps mark the time the bytes became
+ * readable, USB serial adapters deliver in bursts unless set to low latency.
+ */
+export class TtyFramer extends EventEmitter {
+    public readonly gap: number;
+    private _framer: INativeTtyFramer;
+
+    constructor(public readonly fd: number, options?: ITtyFramerOptions) {
+        super();
+        const opts = options || {};
+        const delimiter = opts.delimiter === undefined ? -1 : opts.delimiter;
+        const length = opts.length || 0;
+        this.gap = opts.gap !== undefined
+            ? opts.gap
+            : (delimiter === -1 && !length) ? TtyFramer.charTime(opts.termios || new Termios(fd)) * 3.5 : 0;
+        this._framer = new native.TtyFramer(fd, this.gap, delimiter, length, opts.maxFrame || 4096,
+            (data, frames, status) => this._onFrames(data, frames, status));
+    }
+
+    /**
+     * Time of a single character in microseconds as set in `termios`
+     * (start bit, CSIZE data bits, PARENB parity bit and CSTOPB stop bits).
+     */
+    public static charTime(termios: ITermios): number {
+        const rate = termios.getRate();
+        if (rate <= 0) {
+            throw new Error('unknown bit rate');
+        }
+        const cflag = termios.c_cflag;
+        const sizes: {[flag: number]: number} = {[s.CS5]: 5, [s.CS6]: 6, [s.CS7]: 7, [s.CS8]: 8};
+        const bits = 1 + sizes[cflag & s.CSIZE] + ((cflag & s.PARENB) ? 1 : 0) + ((cflag & s.CSTOPB) ? 2 : 1);
+        return bits * 1000000 / rate;
+    }
+
+    /** Stop the native thread, an incomplete frame is dropped. */
+    public close(): void {
+        this._framer.close();
+    }
+
+    private _onFrames(data: Buffer, frames: Float64Array, status?: number): void {
+        for (let i = 0; i < frames.length; i += 5) {
+            const frame: IFrame = {
+                data: data.subarray(frames[i], frames[i] + frames[i + 1]),
+                start: frames[i + 2],
+                end: frames[i + 3],
+                reason: frames[i + 4]
+            };
+            this.emit('frame', frame);
+        }
+        if (status === 0) {
+            this.emit('end');
+        } else if (status !== undefined) {
+            this.emit('error', new Error(`read failed - ${native.raw.strerror(-status)}`));
+        }
+    }
+}
+
+/**
+ * Coalescing writer for a tty fd.
+ *
+ * Small writes are gathered and flushed with a single `writev` at the end
+ * of the current tick (or once `threshold` bytes are queued), e.g. all escape
+ * sequences of a screen redraw in one syscall. Do not alter buffers after
+ * handing them to `write`. Write errors are emitted as 'error'.
+ */
+export class TtyWriter extends EventEmitter {
+    public readonly fd: number;
+    private _threshold: number;
+    private _maxDelay: number;
+    private _bytesPerMs: number;
+    private _queue: Buffer[] = [];
+    private _queued = 0;
+    private _scheduled = false;
+    private _retry: any = null;
+    private _drains: {resolve: () => void, reject: (err: Error) => void}[] = [];
+    private _polling = false;
+    private _writes = 0;
+    private _bytes = 0;
+    private _syscalls = 0;
+
+    constructor(fd: number, options?: ITtyWriterOptions) {
+        super();
+        const opts = options || {};
+        this.fd = fd;
+        this._threshold = opts.threshold || 16384;
+        this._maxDelay = opts.maxDelay || 50;
+        const rate = new Termios(fd).getRate();
+        this._bytesPerMs = (rate > 0 ? rate : 9600) / 10000;
+    }
+
+    /** Queue `data`, flushed at the end of the tick. */
+    public write(data: Buffer | string): void {
+        const chunk = typeof data === 'string' ? Buffer.from(data) : data;
+        this._writes++;
+        if (!chunk.length) {
+            return;
+        }
+        this._queue.push(chunk);
+        this._queued += chunk.length;
+        if (this._queued >= this._threshold) {
+            this.flush();
+        } else if (!this._scheduled) {
+            this._scheduled = true;
+            process.nextTick(() => {
+                this._scheduled = false;
+                this.flush();
+            });
+        }
+    }
+
+    /** Write queued data now (as far as the fd accepts it). */
+    public flush(): void {
+        const queue = this._queue;
+        while (queue.length && !this._retry) {
+            const result = native.writev(this.fd, queue);
+            this._syscalls++;
+            if (result < 0) {
+                if (result === -native.ERRNO.EAGAIN) {
+                    // nonblocking fd with a full queue
+                    this._retry = setTimeout(() => {
+                        this._retry = null;
+                        this.flush();
+                    }, this._delay(this._queued));
+                    return;
+                }
+                this._fail(new Error(`writev failed - ${native.raw.strerror(-result)}`));
+                return;
+            }
+            this._bytes += result;
+            this._queued -= result;
+            let done = 0;
+            let rest = result;
+            while (done < queue.length && rest >= queue[done].length) {
+                rest -= queue[done++].length;
+            }
+            queue.splice(0, done);
+            if (rest) {
+                queue[0] = queue[0].subarray(rest);
+            }
+        }
+        if (!queue.length) {
+            this._pollOutq();
+        }
+    }
+
+    /**
+     * Resolves once all queued data was written and the output queue
+     * of the tty is empty (polled with TIOCOUTQ instead of a blocking tcdrain).
+     */
+    public drain(): Promise<void> {
+        return new Promise<void>((resolve, reject) => {
+            this._drains.push({resolve, reject});
+            if (!this._queue.length) {
+                this._pollOutq();
+            }
+        });
+    }
+
+    public get stats(): ITtyWriterStats {
+        return {
+            writes: this._writes,
+            bytes: this._bytes,
+            syscalls: this._syscalls,
+            ratio: this._syscalls ? this._writes / this._syscalls : 0
+        };
+    }
+
+    private _pollOutq(): void {
+        if (!this._drains.length || this._polling) {
+            return;
+        }
+        let pending: number;
+        try {
+            pending = native.outq(this.fd);
+        } catch (e) {
+            // no TIOCOUTQ (Solaris)
+            this._polling = true;
+            tcdrainAsync(this.fd).then(() => {
+                this._polling = false;
+                this._resolveDrains();
+            }, err => {
+                this._polling = false;
+                this._fail(err);
+            });
+            return;
+        }
+        if (!pending) {
+            this._resolveDrains();
+            return;
+        }
+        this._polling = true;
+        setTimeout(() => {
+            this._polling = false;
+            if (!this._queue.length) {
+                this._pollOutq();
+            }
+        }, this._delay(pending));
+    }
+
+    private _resolveDrains(): void {
+        const drains = this._drains;
+        this._drains = [];
+        for (const drain of drains) {
+            drain.resolve();
+        }
+    }
+
+    private _fail(err: Error): void {
+        this._queue = [];
+        this._queued = 0;
+        const drains = this._drains;
+        this._drains = [];
+        for (const drain of drains) {
+            drain.reject(err);
+        }
+        this.emit('error', err);
+    }
+
+    /** Roughly the time needed to transmit `bytes`. */
+    private _delay(bytes: number): number {
+        return Math.max(1, Math.min(this._maxDelay, bytes / this._bytesPerMs));
     }
 }
@@ -141,6 +141,18 @@ export interface IFLOW {
     TCION: number;
 }
 
+// pty packet mode control bytes
+export interface IPKT {
+    TIOCPKT_DATA: number;
+    TIOCPKT_FLUSHREAD: number;
+    TIOCPKT_FLUSHWRITE: number;
+    TIOCPKT_STOP: number;
+    TIOCPKT_START: number;
+    TIOCPKT_NOSTOP: number;
+    TIOCPKT_DOSTOP: number;
+    TIOCPKT_IOCTL?: number;
+}
+
 // baud rates
 export interface IBAUD {
     B0: number;
@@ -211,12 +223,83 @@ interface ITermiosExplain {
         };
     }
 }
+export interface ICacheStats {
+    enabled: boolean;
+    hits: number;
+    misses: number;
+    entries: number;
+}
+
+export interface IWinsize {
+    rows: number;
+    cols: number;
+    xpixel?: number;
+    ypixel?: number;
+}
+
+/**
+ * result of restoring a snapshot record (native.snapshot_restore_all)
+ */
+export interface ISnapshotResult {
+    /** Device path at recording time. */
+    path: string;
+    dev: number;
+    ino: number;
+    /** Recording time in ms since epoch. */
+    timestamp: number;
+    /** 0 or negative errno value (-ENODEV if the path belongs to another device now). */
+    error: number;
+}
+
+export interface IOpenptyOptions {
+    /** Number of pty pairs to allocate (default: 1, at most RLIMIT_NOFILE / 2). */
+    count?: number;
+    /** Window size applied to the new ptys. */
+    winsize?: IWinsize;
+    /** Termios data applied to the new ptys (Termios._data or a buffer of EXPLAIN.size). */
+    termios?: Buffer;
+}
+
+export interface IPtyPair {
+    master: number;
+    slave: number;
+    path: string;
+}
+
+export type IAsyncCallback = (err: Error | null) => void;
+
 export interface INative {
     isatty(fd: number): boolean;
     ttyname(fd: number): string;
     ptsname(fd: number): string;
+    openpty(options?: IOpenptyOptions): IPtyPair[];
+    packet_mode(fd: number, enable: boolean): void;
     tcgetattr(fd: number, buffer: Buffer): void;
     tcsetattr(fd: number, action: number, buffer: Buffer): void;
+    tcgetattr_many(fds: number[], buffer: Buffer): number[];
+    tcsetattr_many(fds: number[], action: number, buffer: Buffer): number[];
+    cache_enable(enable: boolean): void;
+    cache_invalidate(fd?: number): void;
+    cache_stats(): ICacheStats;
+    inq(fd: number): number;
+    outq(fd: number): number;
+    inq_many(fds: number[]): number[];
+    writev(fd: number, buffers: Buffer[]): number;
+    getwinsize(fd: number, buffer: Buffer): void;
+    setwinsize(fd: number, rows: number, cols: number, xpixel?: number, ypixel?: number): void;
+    setwinsize_many(fds: number[], buffer: Buffer): number[];
+    winsize_cache_enable(enable: boolean): void;
+    winsize_invalidate(fd?: number): void;
+    winsize_cache_stats(): {enabled: boolean, generation: number, hits: number, misses: number, entries: number};
+    snapshot_open(path: string, capacity?: number): number;
+    snapshot_close(): void;
+    snapshot_save(fd: number, overwrite?: boolean): number;
+    snapshot_forget(fd: number): boolean;
+    snapshot_restore_all(path: string, action?: number): ISnapshotResult[];
+    stats_enable(enable: boolean): void;
+    stats(): IStats;
+    resetStats(): void;
+    outq_many(fds: number[]): number[];
     tcsendbreak(fd: number, duration: number): void;
     tcdrain(fd: number): void;
     tcflush(fd: number, queue_selector: number): void;
@@ -225,8 +308,39 @@ export interface INative {
     cfgetospeed(buffer: Buffer): number;
     cfsetispeed(buffer: Buffer, speed: number): void;
     cfsetospeed(buffer: Buffer, speed: number): void;
+    cfgetrate(buffer: Buffer): number;
+    cfsetrate(buffer: Buffer, rate: number): void;
+    baud_to_rate(baud: number): number;
+    rate_to_baud(rate: number): number;
+    ARBITRARY_BAUD: boolean;
     load_ttydefaults(buffer: Buffer): boolean;
-    ALL_SYMBOLS: IIFLAGS & IOFLAGS & ICFLAGS & ILFLAGS & ICC & IACTION & IFLUSH & IFLOW & IBAUD;
+    tcdrain_async(fd: number, timeout: number, cancel: Buffer | null, callback: IAsyncCallback): void;
+    tcsendbreak_async(fd: number, duration: number, timeout: number, cancel: Buffer | null,
+                      callback: IAsyncCallback): void;
+    tcsetattr_async(fd: number, action: number, buffer: Buffer, timeout: number, cancel: Buffer | null,
+                    callback: IAsyncCallback): void;
+    SHARED_HEADER: number;
+    shared_load(fd: number, slot: Buffer, owned?: boolean): void;
+    shared_store(fd: number, action: number, slot: Buffer, owned?: boolean): void;
+    shared_snapshot(slot: Buffer, buffer: Buffer): void;
+    stty_compile(spec: string): Buffer;
+    stty_apply(patch: Buffer, buffer: Buffer): void;
+    stty_describe(buffer: Buffer): ISttyDescription;
+    stty_describe(buffer: Buffer, text: true): string;
+    MODE: IMODE;
+    TRANSLATE: {OUTPUT: number, INPUT: number};
+    PARMRK: {ERROR: number, BREAK: number, STATE_SIZE: number};
+    parmrk_decode(buffer: Buffer, input: Buffer, output: Buffer, state: Uint32Array, errors: Uint32Array): number;
+    translate(buffer: Buffer, direction: number, input: Buffer, output: Buffer, state?: Buffer): number;
+    apply_mode(buffer: Buffer, preset: number): void;
+    setmode(fd: number, preset: number, action: number, prev?: Buffer | null, snapshot?: Buffer): void;
+    TtyReader: INativeTtyReaderCtor;
+    TtyMux: INativeTtyMuxCtor;
+    TtyFramer: INativeTtyFramerCtor;
+    FRAME: {GAP: number, DELIMITER: number, LENGTH: number, OVERFLOW: number, FLUSH: number};
+    raw: INativeRaw;
+    ERRNO: {[name: string]: number};
+    ALL_SYMBOLS: IIFLAGS & IOFLAGS & ICFLAGS & ILFLAGS & ICC & IACTION & IFLUSH & IFLOW & IBAUD & IPKT;
     IFLAGS: IIFLAGS;
     OFLAGS: IOFLAGS;
     CFLAGS: ICFLAGS;
@@ -236,24 +350,296 @@ export interface INative {
     FLUSH: IFLUSH;
     FLOW: IFLOW;
     BAUD: IBAUD;
+    PKT: IPKT;
+    SYMBOL_GROUPS: string[];
     EXPLAIN: ITermiosExplain;
 }
 
-export interface IDataAccessor {
-    BE: {
-        4: {
-            read: (b: Buffer, offset: number) => number;
-            write: (b: Buffer, value: number, offset: number) => number;
-        }
-    };
-    LE: {
-        4: {
-            read: (b: Buffer, offset: number) => number;
-            write: (b: Buffer, value: number, offset: number) => number;
-        }
+/**
+ * content of the generated constants module
+ */
+export type IConstants = Pick<INative, 'IFLAGS' | 'OFLAGS' | 'CFLAGS' | 'LFLAGS' | 'CC' | 'ACTION'
+    | 'FLUSH' | 'FLOW' | 'BAUD' | 'PKT' | 'ALL_SYMBOLS' | 'EXPLAIN'>;
+
+/**
+ * non throwing variants, return 0 (isatty: 1/0) or a negative errno value
+ */
+export interface INativeRaw {
+    isatty(fd: number): number;
+    tcgetattr(fd: number, buffer: Buffer): number;
+    tcsetattr(fd: number, action: number, buffer: Buffer): number;
+    tcflush(fd: number, queue_selector: number): number;
+    tcflow(fd: number, action: number): number;
+    tcdrain(fd: number): number;
+    errname(code: number): string;
+    strerror(code: number): string;
+}
+
+/**
+ * native TtyReader - reads a tty fd into slots of a preallocated slab
+ */
+export type ITtyReaderCallback = (err: Error | null, slot: number, length: number, control: number) => void;
+
+export interface INativeTtyReader {
+    start(): void;
+    stop(): void;
+    release(slot: number): void;
+    close(): void;
+}
+
+export interface INativeTtyReaderCtor {
+    new (fd: number, slab: Buffer, chunkSize: number, callback: ITtyReaderCallback, packet?: boolean): INativeTtyReader;
+}
+
+/**
+ * native TtyMux - reads many tty fds from a single thread into slots of a slab,
+ * reported as (fd, slot, length) triples once per event loop turn
+ */
+export type ITtyMuxCallback = (records: Int32Array) => void;
+
+export interface INativeTtyMux {
+    add(fd: number, vmin?: number, vtime?: number): void;
+    remove(fd: number): void;
+    release(slot: number): void;
+    close(): void;
+}
+
+export interface INativeTtyMuxCtor {
+    new (slab: Buffer, chunkSize: number, callback: ITtyMuxCallback): INativeTtyMux;
+}
+
+/**
+ * options of TtyMux
+ */
+export interface ITtyMuxOptions {
+    /** Size of a single slot in bytes (default: 4096). */
+    chunkSize?: number;
+    /** Number of slots shared by all fds (default: 64). */
+    chunks?: number;
+}
+
+/**
+ * data of a single fd in a TtyMux 'data' batch
+ */
+export interface ITtyMuxChunk {
+    fd: number;
+    /** View into the slab, only valid within the 'data' handler. */
+    data: Buffer;
+}
+
+/**
+ * native TtyFramer - splits tty input into frames on a dedicated thread,
+ * reported as frame data and (offset, length, start_us, end_us, reason) per frame
+ * once per event loop turn, `status` is set on the end of the fd (0: EOF, otherwise -errno)
+ */
+export type ITtyFramerCallback = (data: Buffer, frames: Float64Array, status?: number) => void;
+
+export interface INativeTtyFramer {
+    close(): void;
+}
+
+export interface INativeTtyFramerCtor {
+    new (fd: number, gapUs: number, delimiter: number, length: number, maxFrame: number,
+         callback: ITtyFramerCallback): INativeTtyFramer;
+}
+
+/**
+ * options of TtyFramer, a frame ends at the first matching rule
+ */
+export interface ITtyFramerOptions {
+    /**
+     * Inter-byte gap in microseconds, that ends a frame (0 disables).
+     * Default: 3.5 character times of `termios`, if neither `delimiter` nor `length` are set.
+     */
+    gap?: number;
+    /** Byte value ending a frame (included in the frame). */
+    delimiter?: number;
+    /** Fixed frame length. */
+    length?: number;
+    /** Max. frame length, longer frames are split (default: 4096, at most 16 MiB). */
+    maxFrame?: number;
+    /** Settings to derive the default gap from (loaded from fd if omitted). */
+    termios?: ITermios;
+}
+
+/**
+ * frame emitted by TtyFramer
+ */
+export interface IFrame {
+    data: Buffer;
+    /** CLOCK_MONOTONIC arrival time of the first and last byte in microseconds. */
+    start: number;
+    end: number;
+    /** native.FRAME value. */
+    reason: number;
+}
+
+/**
+ * options of the async functions
+ */
+export interface IAsyncOptions {
+    /** Timeout in msec (default: no timeout). */
+    timeout?: number;
+    /** Token to cancel a pending operation. */
+    cancel?: ICancelToken;
+}
+
+export interface ICancelToken {
+    readonly canceled: boolean;
+    cancel(): void;
+}
+
+/**
+ * options of TtyReadStream
+ */
+export interface ITtyReadStreamOptions {
+    /** Size of a single ring slot in bytes (default: 4096). */
+    chunkSize?: number;
+    /** Number of slots in the ring (default: 16). */
+    chunks?: number;
+    /** Enable packet mode on a pty master fd (default: false). */
+    packet?: boolean;
+    /**
+     * Push views into the ring instead of copies (default: false).
+     * Chunks are only valid within the 'data' handler then.
+     */
+    zeroCopy?: boolean;
+}
+
+/**
+ * options of TtyWriteStream
+ */
+export interface ITtyWriteStreamOptions {
+    /** Output queue depth in bytes, above which writing waits (default: 256). */
+    queueLimit?: number;
+    /** Upper bound of a single wait for the output queue in msec (default: 50). */
+    maxDelay?: number;
+    /** Writable highWaterMark in bytes (default: 16384). */
+    highWaterMark?: number;
+}
+
+/**
+ * termios data in stty notation (Termios.describe)
+ */
+export interface ISttyDescription {
+    /** Bit rate, -1 if unknown. */
+    speed: number;
+    /** Flags as `echo` (set) or `-echo` (unset), multi bit fields by value (`cs8`). */
+    iflag: string[];
+    oflag: string[];
+    cflag: string[];
+    lflag: string[];
+    /** Control characters by stty name, e.g. {intr: '^C', eol: '<undef>', min: '1'}. */
+    cc: {[name: string]: string};
+}
+
+/**
+ * mode presets of native.setmode
+ */
+export interface IMODE {
+    RAW: number;
+    CBREAK: number;
+    COOKED: number;
+    /** Not available on Solaris. */
+    CFMAKERAW?: number;
+    SNAPSHOT: number;
+}
+
+/**
+ * restore handle of Termios.enterRaw / enterMode
+ */
+export interface IModeHandle {
+    readonly fd: number;
+    /** Settings before the mode switch. */
+    readonly previous: ITermios;
+    /** Write the previous settings back (single native call). */
+    restore(action?: number): void;
+}
+
+/**
+ * error record of ParmrkDecoder
+ */
+export interface IParmrkError {
+    /** Offset in the decoded chunk, where the erroneous byte was removed. */
+    offset: number;
+    /** native.PARMRK.ERROR (parity/framing) or native.PARMRK.BREAK. */
+    kind: number;
+    /** The received byte (0 for breaks). */
+    value: number;
+}
+
+/**
+ * counters of ParmrkDecoder
+ */
+export interface IParmrkStats {
+    bytes: number;
+    errors: number;
+    breaks: number;
+    escaped: number;
+    /** Error records, that did not fit into the side channel. */
+    dropped: number;
+}
+
+/**
+ * compiled stty spec (SttyPatch)
+ */
+export interface ISttyPatch {
+    readonly spec: string;
+}
+
+/**
+ * syscall counters of a single operation (native.stats)
+ */
+export interface IOpStats {
+    calls: number;
+    errors: number;
+    /** EINTR retries. */
+    eintr: number;
+    /** Summed latency in ns (including retries). */
+    totalNs: number;
+    /** Errors by errno name. */
+    errno: {[name: string]: number};
+    /** Calls per log2 latency bucket, index i: [2^i, 2^(i+1)) ns. */
+    histogram: number[];
+}
+
+export interface IStats {
+    enabled: boolean;
+    ops: {
+        tcgetattr: IOpStats;
+        tcsetattr: IOpStats;
+        tcsendbreak: IOpStats;
+        tcdrain: IOpStats;
+        tcflush: IOpStats;
+        tcflow: IOpStats;
+        writev: IOpStats;
     };
 }
 
+/**
+ * options of TtyWriter
+ */
+export interface ITtyWriterOptions {
+    /** Queued bytes, that trigger an immediate flush (default: 16384). */
+    threshold?: number;
+    /** Upper bound of a single wait for the output queue in msec (default: 50). */
+    maxDelay?: number;
+}
+
+/**
+ * counters of TtyWriter
+ */
+export interface ITtyWriterStats {
+    /** Calls of `write`. */
+    writes: number;
+    /** Bytes written to the fd. */
+    bytes: number;
+    /** writev syscalls. */
+    syscalls: number;
+    /** Writes per syscall. */
+    ratio: number;
+}
+
 /**
  * interface of Termios
  */
@@ -264,15 +650,23 @@ export interface ITermios {
     c_lflag: number;
     c_cc: Buffer;
     writeTo(fd: number, action?: number): void;
+    writeToAsync(fd: number, action?: number, options?: IAsyncOptions): Promise<void>;
     loadFrom(fd: number): void;
+    readonly shared: SharedArrayBuffer | null;
+    update(fn: (termios: ITermios) => void): void;
+    snapshot(): ITermios;
     getInputSpeed(): number;
     getInputSpeed(): number;
     setInputSpeed(baudrate: number): void;
     setOutputSpeed(baudrate: number): void;
     setSpeed(baudrate: number): void;
+    getRate(): number;
     setraw(): void;
     setcbreak(): void;
     setcooked(): void;
+    stty(spec: string | ISttyPatch): void;
+    describe(): ISttyDescription;
+    toStty(): string;
 }
 
 export interface ITermiosCtor {
@@ -27,12 +27,6 @@ using namespace v8;
 // path length for ttyname / ptsname
 #define CUSTOM_MAX_TTY_PATH 256
 
-// macro for symbol export
-#define TERMIOS_EXPORT(o, js_obj, sym)                                        \
-Nan::Set(all, Nan::New<String>(#sym).ToLocalChecked(),Nan::New<Number>(sym)); \
-Nan::Set(js_obj, Nan::New<String>(#sym).ToLocalChecked(),Nan::New<Number>(sym))
-
-
 // macro for module export
 #define MODULE_EXPORT(name, symbol)                                           \
 Nan::Set(target, Nan::New<String>(name).ToLocalChecked(), symbol)
@@ -48,6 +42,28 @@ Nan::Set(target, Nan::New<String>(name).ToLocalChecked(), symbol)
   })
 #endif
 
+/**
+ * Helpers for the hot paths (tcgetattr, tcsetattr, cf*speed).
+ *
+ * Native methods already run within a handle scope and the integer arguments
+ * get checked with IsInt32, thus they can be read without a context lookup.
+ * Termios data is accepted from buffers (as before, Buffer::HasInstance takes
+ * any ArrayBufferView) of exactly sizeof(struct termios) bytes,
+ * NULL is returned otherwise.
+ */
+static inline int int32_arg(Local<Value> value)
+{
+    return value.As<Int32>()->Value();
+}
+
+static inline struct termios *termios_arg(Local<Value> value)
+{
+    if (!Buffer::HasInstance(value) || Buffer::Length(value) != sizeof(struct termios)) {
+        return NULL;
+    }
+    return (struct termios *) Buffer::Data(value);
+}
+
 // macros to explain structure
 #define member_size(type, member) sizeof(((type *)0)->member)
 
@@ -0,0 +1,62 @@
+/* termios2_linux.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ * Note: Must not include termios.h (directly or indirectly).
+ */
+#include "termios2_linux.h"
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+#include <errno.h>
+#include <string.h>
+
+#define KERNEL_NCCS (sizeof(((struct termios2 *) 0)->c_cc))
+
+const unsigned int TERMIOS2_BOTHER = BOTHER;
+
+
+int termios2_get(int fd, struct termios2_data *data)
+{
+    struct termios2 t;
+    if (ioctl(fd, TCGETS2, &t) == -1) {
+        return -1;
+    }
+    data->iflag = t.c_iflag;
+    data->oflag = t.c_oflag;
+    data->cflag = t.c_cflag;
+    data->lflag = t.c_lflag;
+    data->line = t.c_line;
+    memset(data->cc, 0, sizeof(data->cc));
+    memcpy(data->cc, t.c_cc, (KERNEL_NCCS < sizeof(data->cc)) ? KERNEL_NCCS : sizeof(data->cc));
+    data->ispeed = t.c_ispeed;
+    data->ospeed = t.c_ospeed;
+    return 0;
+}
+
+
+int termios2_set(int fd, int mode, const struct termios2_data *data)
+{
+    unsigned long request;
+    switch (mode) {
+        case TERMIOS2_NOW: request = TCSETS2; break;
+        case TERMIOS2_DRAIN: request = TCSETSW2; break;
+        case TERMIOS2_FLUSH: request = TCSETSF2; break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+    struct termios2 t;
+    memset(&t, 0, sizeof(t));
+    t.c_iflag = data->iflag;
+    t.c_oflag = data->oflag;
+    t.c_cflag = data->cflag;
+    t.c_lflag = data->lflag;
+    t.c_line = data->line;
+    memcpy(t.c_cc, data->cc, (KERNEL_NCCS < sizeof(data->cc)) ? KERNEL_NCCS : sizeof(data->cc));
+    t.c_ispeed = data->ispeed;
+    t.c_ospeed = data->ospeed;
+    return ioctl(fd, request, &t);
+}
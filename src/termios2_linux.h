@@ -0,0 +1,42 @@
+/* termios2_linux.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TERMIOS2_LINUX_H
+#define TERMIOS2_LINUX_H
+
+/**
+ * Linux termios2 ioctls (TCGETS2/TCSETS2) for arbitrary baud rates.
+ *
+ * The kernel headers defining `struct termios2` clash with the libc termios.h,
+ * thus the ioctls live in their own translation unit and data is exchanged
+ * with this plain struct. `cc` indices match the libc V* symbols,
+ * only the entries known to the kernel are transferred.
+ */
+struct termios2_data {
+    unsigned int iflag;
+    unsigned int oflag;
+    unsigned int cflag;
+    unsigned int lflag;
+    unsigned char line;
+    unsigned char cc[32];
+    unsigned int ispeed;
+    unsigned int ospeed;
+};
+
+// termios2_set modes, equivalent of TCSANOW, TCSADRAIN and TCSAFLUSH
+#define TERMIOS2_NOW 0
+#define TERMIOS2_DRAIN 1
+#define TERMIOS2_FLUSH 2
+
+// kernel flag for a non table baud rate in c_cflag
+extern const unsigned int TERMIOS2_BOTHER;
+
+// both return 0 on success, -1 with errno set otherwise
+int termios2_get(int fd, struct termios2_data *data);
+int termios2_set(int fd, int mode, const struct termios2_data *data);
+
+#endif // TERMIOS2_LINUX_H
@@ -0,0 +1,264 @@
+/* termios_async.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "termios_async.h"
+#include "termios_cache.h"
+#include "termios_stats.h"
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+// poll interval while waiting for the output queue to drain
+#define DRAIN_POLL_NS 2000000L
+
+
+static int64_t monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+static bool is_canceled(const char *cancel)
+{
+    return cancel && __atomic_load_n(cancel, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Wait for the output queue of `fd` to drain.
+ *
+ * Other than a plain `tcdrain` this polls the queue size with TIOCOUTQ,
+ * thus the wait can be interrupted by a timeout or cancel request.
+ * Falls back to `tcdrain` alone, if the driver does not support TIOCOUTQ.
+ * Returns 0 on success or an errno value.
+ */
+static int wait_drained(int fd, int64_t deadline, const char *cancel)
+{
+    #ifdef TIOCOUTQ
+    for (;;) {
+        if (is_canceled(cancel)) {
+            return ECANCELED;
+        }
+        int pending = 0;
+        if (ioctl(fd, TIOCOUTQ, &pending) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (!pending) {
+            break;
+        }
+        int64_t wait = DRAIN_POLL_NS;
+        if (deadline) {
+            int64_t left = deadline - monotonic_ns();
+            if (left <= 0) {
+                return ETIMEDOUT;
+            }
+            if (left < wait) {
+                wait = left;
+            }
+        }
+        struct timespec ts = {0, (long) wait};
+        nanosleep(&ts, NULL);
+    }
+    #endif
+    if (is_canceled(cancel)) {
+        return ECANCELED;
+    }
+    int res;
+    TERMIOS_CALL(STAT_TCDRAIN, res = tcdrain(fd));
+    return (res) ? errno : 0;
+}
+
+
+/**
+ * Base class of the termios workers.
+ *
+ * Holds the common fd, timeout and cancel state and reports
+ * `err` as first callback argument in the usual "<func> failed - <msg>" form.
+ * The cancel flag is a small buffer owned by JS, any non zero value
+ * in the first byte requests cancelation.
+ */
+class TermiosWorker : public Nan::AsyncWorker {
+public:
+    TermiosWorker(Nan::Callback *callback, const char *fname, int fd, int timeout, Local<Value> cancel)
+        : Nan::AsyncWorker(callback, fname), fname(fname), fd(fd), deadline(0), cancel(NULL), err(0)
+    {
+        if (timeout > 0) {
+            deadline = monotonic_ns() + timeout * 1000000LL;
+        }
+        if (Buffer::HasInstance(cancel)) {
+            SaveToPersistent("cancel", cancel);
+            this->cancel = Buffer::Data(cancel);
+        }
+    }
+
+    void HandleOKCallback()
+    {
+        Nan::HandleScope scope;
+        Local<Value> argv[] = {Nan::Null()};
+        if (err) {
+            std::string error(strerror(err));
+            argv[0] = Nan::Error((std::string(fname) + " failed - " + error).c_str());
+        }
+        callback->Call(1, argv, async_resource);
+    }
+
+protected:
+    const char *fname;
+    int fd;
+    int64_t deadline;
+    const char *cancel;
+    int err;
+};
+
+
+class TcdrainWorker : public TermiosWorker {
+public:
+    TcdrainWorker(Nan::Callback *callback, int fd, int timeout, Local<Value> cancel)
+        : TermiosWorker(callback, "tcdrain", fd, timeout, cancel) {}
+
+    void Execute()
+    {
+        err = wait_drained(fd, deadline, cancel);
+    }
+};
+
+
+class TcsendbreakWorker : public TermiosWorker {
+public:
+    TcsendbreakWorker(Nan::Callback *callback, int fd, int duration, int timeout, Local<Value> cancel)
+        : TermiosWorker(callback, "tcsendbreak", fd, timeout, cancel), duration(duration) {}
+
+    void Execute()
+    {
+        // a running break cannot be interrupted, thus only test before sending it
+        if (is_canceled(cancel)) {
+            err = ECANCELED;
+            return;
+        }
+        if (deadline && monotonic_ns() >= deadline) {
+            err = ETIMEDOUT;
+            return;
+        }
+        int res;
+        TERMIOS_CALL(STAT_TCSENDBREAK, res = tcsendbreak(fd, duration));
+        err = (res) ? errno : 0;
+    }
+
+private:
+    int duration;
+};
+
+
+class TcsetattrWorker : public TermiosWorker {
+public:
+    TcsetattrWorker(Nan::Callback *callback, int fd, int action,
+                    struct termios *attrs, int timeout, Local<Value> cancel)
+        : TermiosWorker(callback, "tcsetattr", fd, timeout, cancel), action(action)
+    {
+        // copy data, JS might alter the buffer while we are running
+        memcpy(&this->attrs, attrs, sizeof(struct termios));
+    }
+
+    void Execute()
+    {
+        // drain upfront with our interruptible wait,
+        // tcsetattr will find an empty output queue afterwards
+        int base_action = action;
+        #ifdef TCSASOFT
+        base_action &= ~TCSASOFT;
+        #endif
+        if (base_action != TCSANOW) {
+            err = wait_drained(fd, deadline, cancel);
+            if (err) {
+                return;
+            }
+        }
+        int res = cached_tcsetattr(fd, action, &attrs);
+        err = (res) ? errno : 0;
+    }
+
+private:
+    int action;
+    struct termios attrs;
+};
+
+
+static bool is_cancel_arg(Local<Value> arg)
+{
+    return arg->IsNull() || arg->IsUndefined()
+        || (Buffer::HasInstance(arg) && Buffer::Length(arg) >= 1);
+}
+
+
+NAN_METHOD(TcdrainAsync)
+{
+    if (info.Length() != 4
+          || !info[0]->IsNumber()
+          || !info[1]->IsNumber()
+          || !is_cancel_arg(info[2])
+          || !info[3]->IsFunction()) {
+        return Nan::ThrowError("usage: termios.tcdrain_async(fd, timeout, cancel, callback)");
+    }
+    Nan::AsyncQueueWorker(new TcdrainWorker(
+        new Nan::Callback(info[3].As<Function>()),
+        Nan::To<int>(info[0]).FromJust(),
+        Nan::To<int>(info[1]).FromJust(),
+        info[2]));
+    info.GetReturnValue().SetUndefined();
+}
+
+
+NAN_METHOD(TcsendbreakAsync)
+{
+    if (info.Length() != 5
+          || !info[0]->IsNumber()
+          || !info[1]->IsNumber()
+          || !info[2]->IsNumber()
+          || !is_cancel_arg(info[3])
+          || !info[4]->IsFunction()) {
+        return Nan::ThrowError("usage: termios.tcsendbreak_async(fd, duration, timeout, cancel, callback)");
+    }
+    Nan::AsyncQueueWorker(new TcsendbreakWorker(
+        new Nan::Callback(info[4].As<Function>()),
+        Nan::To<int>(info[0]).FromJust(),
+        Nan::To<int>(info[1]).FromJust(),
+        Nan::To<int>(info[2]).FromJust(),
+        info[3]));
+    info.GetReturnValue().SetUndefined();
+}
+
+
+NAN_METHOD(TcsetattrAsync)
+{
+    if (info.Length() != 6
+          || !info[0]->IsNumber()
+          || !info[1]->IsNumber()
+          || !info[2]->IsObject()
+          || !info[3]->IsNumber()
+          || !is_cancel_arg(info[4])
+          || !info[5]->IsFunction()) {
+        return Nan::ThrowError("usage: termios.tcsetattr_async(fd, action, buffer, timeout, cancel, callback)");
+    }
+    if (!Buffer::HasInstance(info[2]) || Buffer::Length(info[2]) != sizeof(struct termios)) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    Nan::AsyncQueueWorker(new TcsetattrWorker(
+        new Nan::Callback(info[5].As<Function>()),
+        Nan::To<int>(info[0]).FromJust(),
+        Nan::To<int>(info[1]).FromJust(),
+        (struct termios *) Buffer::Data(info[2]),
+        Nan::To<int>(info[3]).FromJust(),
+        info[4]));
+    info.GetReturnValue().SetUndefined();
+}
@@ -0,0 +1,18 @@
+/* termios_async.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TERMIOS_ASYNC_H
+#define TERMIOS_ASYNC_H
+
+#include "node_termios.h"
+
+// async variants of blocking termios functions (run on libuv threadpool)
+NAN_METHOD(TcdrainAsync);
+NAN_METHOD(TcsendbreakAsync);
+NAN_METHOD(TcsetattrAsync);
+
+#endif // TERMIOS_ASYNC_H
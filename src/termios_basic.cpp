@@ -6,14 +6,28 @@
  * of the MIT license.  See the LICENSE file for details.
  */
 #include "termios_basic.h"
+#include "termios_cache.h"
+#include "termios_speed.h"
+#include "termios_stats.h"
 #include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <vector>
 #include <unistd.h>
 #include <string.h>
+#include <sys/ioctl.h>
+#ifdef SOLARIS
+#include <sys/filio.h>
+#endif
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
 
 
 NAN_METHOD(Isatty)
 {
-    Nan::HandleScope scope;
     if (info.Length() != 1 || !info[0]->IsNumber()) {
         return Nan::ThrowError("usage: termios.isatty(fd)");
     }
@@ -28,7 +42,6 @@ NAN_METHOD(Isatty)
 
 NAN_METHOD(Ttyname)
 {
-    Nan::HandleScope scope;
     if (info.Length() != 1 || !info[0]->IsNumber()) {
         return Nan::ThrowError("usage: termios.ttyname(fd)");
     }
@@ -97,89 +110,301 @@ int ptsname_r_freebsd(int fd, char *buf, size_t buflen) {
 #endif
 
 
-NAN_METHOD(Ptsname)
+/**
+ * Resolve the slave path of a pty master into `buf`.
+ * Returns 0 on success or an errno value.
+ */
+int termios_ptsname(int fd, char *buf, size_t buflen)
 {
-    Nan::HandleScope scope;
-    if (info.Length() != 1 || !info[0]->IsNumber()) {
-        return Nan::ThrowError("usage: termios.ptsname(fd)");
-    }
     #ifdef SOLARIS
         // solaris claims to have thread-safe ptsname
-        char *buf = ptsname(Nan::To<int>(info[0]).FromJust());
-        int res = (buf) ? 0 : 1;
+        char *name = ptsname(fd);
+        if (!name) {
+            return (errno) ? errno : ENOTTY;
+        }
+        if (strlen(name) + 1 > buflen) {
+            return ERANGE;
+        }
+        strcpy(buf, name);
+        return 0;
+    #elif defined __APPLE__
+        return (ptsname_r_darwin(fd, buf, buflen)) ? errno : 0;
+    #elif defined __FreeBSD__
+        return (ptsname_r_freebsd(fd, buf, buflen)) ? errno : 0;
     #else
-        char buf[CUSTOM_MAX_TTY_PATH] = "";
-        #ifdef __APPLE__
-        int res = ptsname_r_darwin(Nan::To<int>(info[0]).FromJust(), buf, CUSTOM_MAX_TTY_PATH);
-        #elif defined __FreeBSD__
-        int res = ptsname_r_freebsd(Nan::To<int>(info[0]).FromJust(), buf, CUSTOM_MAX_TTY_PATH);
-        #else
-        int res = ptsname_r(Nan::To<int>(info[0]).FromJust(), buf, CUSTOM_MAX_TTY_PATH);
-        #endif
+        int res = ptsname_r(fd, buf, buflen);
+        return (res) ? ((res == -1) ? errno : res) : 0;
     #endif
+}
+
+
+/**
+ * Identify the tty behind `fd` by device id and inode.
+ * All fds of a tty share the identity, for a pty master the slave is used,
+ * since both ends share termios settings and window size.
+ * Returns 0 on success or -1 with errno set.
+ */
+int termios_tty_id(int fd, dev_t *dev, ino_t *ino)
+{
+    struct stat st;
+    char path[CUSTOM_MAX_TTY_PATH];
+    if (!termios_ptsname(fd, path, CUSTOM_MAX_TTY_PATH)) {
+        if (stat(path, &st)) {
+            return -1;
+        }
+    } else if (fstat(fd, &st)) {
+        return -1;
+    }
+    *dev = st.st_dev;
+    *ino = st.st_ino;
+    return 0;
+}
+
+
+NAN_METHOD(Ptsname)
+{
+    if (info.Length() != 1 || !info[0]->IsNumber()) {
+        return Nan::ThrowError("usage: termios.ptsname(fd)");
+    }
+    char buf[CUSTOM_MAX_TTY_PATH] = "";
+    int res = termios_ptsname(Nan::To<int>(info[0]).FromJust(), buf, CUSTOM_MAX_TTY_PATH);
     info.GetReturnValue().Set(
         (res) ? Nan::EmptyString() : Nan::New<String>(buf).ToLocalChecked());
 }
 
 
+/**
+ * Queue depth of a tty - bytes waiting in the input queue (FIONREAD)
+ * or not yet transmitted from the output queue (TIOCOUTQ).
+ * Returns the depth or a negative errno value.
+ */
+static int queue_depth(int fd, bool output)
+{
+    int depth = 0;
+    int res;
+    if (output) {
+        #ifdef TIOCOUTQ
+        TEMP_FAILURE_RETRY(res = ioctl(fd, TIOCOUTQ, &depth));
+        #else
+        errno = ENOTSUP;
+        res = -1;
+        #endif
+    } else {
+        TEMP_FAILURE_RETRY(res = ioctl(fd, FIONREAD, &depth));
+    }
+    return (res) ? -errno : depth;
+}
+
+
+NAN_METHOD(Inq)
+{
+    if (info.Length() != 1 || !info[0]->IsNumber()) {
+        return Nan::ThrowError("usage: termios.inq(fd)");
+    }
+    int depth = queue_depth(Nan::To<int>(info[0]).FromJust(), false);
+    if (depth < 0) {
+        std::string error(strerror(-depth));
+        return Nan::ThrowError((std::string("inq failed - ") + error).c_str());
+    }
+    info.GetReturnValue().Set(Nan::New<Number>(depth));
+}
+
+
+NAN_METHOD(Outq)
+{
+    if (info.Length() != 1 || !info[0]->IsNumber()) {
+        return Nan::ThrowError("usage: termios.outq(fd)");
+    }
+    int depth = queue_depth(Nan::To<int>(info[0]).FromJust(), true);
+    if (depth < 0) {
+        std::string error(strerror(-depth));
+        return Nan::ThrowError((std::string("outq failed - ") + error).c_str());
+    }
+    info.GetReturnValue().Set(Nan::New<Number>(depth));
+}
+
+
+/**
+ * Batch versions of inq / outq.
+ * Return an array with the queue depth for each fd, or the negative errno value
+ * for failing fds.
+ */
+static void queue_depth_many(const Nan::FunctionCallbackInfo<Value> &info, bool output)
+{
+    Local<Array> fds = info[0].As<Array>();
+    uint32_t count = fds->Length();
+    Local<Array> result = Nan::New<Array>(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        int fd = Nan::To<int>(Nan::Get(fds, i).ToLocalChecked()).FromMaybe(-1);
+        Nan::Set(result, i, Nan::New<Number>(queue_depth(fd, output)));
+    }
+    info.GetReturnValue().Set(result);
+}
+
+
+NAN_METHOD(InqMany)
+{
+    if (info.Length() != 1 || !info[0]->IsArray()) {
+        return Nan::ThrowError("usage: termios.inq_many(fds)");
+    }
+    queue_depth_many(info, false);
+}
+
+
+NAN_METHOD(OutqMany)
+{
+    if (info.Length() != 1 || !info[0]->IsArray()) {
+        return Nan::ThrowError("usage: termios.outq_many(fds)");
+    }
+    queue_depth_many(info, true);
+}
+
+
+/**
+ * Gather write of several buffers with a single writev call.
+ * Takes up to IOV_MAX buffers, thus a return value below the total length
+ * means partial write. Returns the bytes written or -errno, write errors
+ * do not throw (wrong arguments or non-Buffer elements still do).
+ */
+NAN_METHOD(Writev)
+{
+    if (info.Length() != 2 || !info[0]->IsInt32() || !info[1]->IsArray()) {
+        return Nan::ThrowError("usage: termios.writev(fd, buffers)");
+    }
+    Local<Array> buffers = info[1].As<Array>();
+    uint32_t count = buffers->Length();
+    if (count > IOV_MAX) {
+        count = IOV_MAX;
+    }
+    std::vector<struct iovec> iov(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        Local<Value> buffer = Nan::Get(buffers, i).ToLocalChecked();
+        if (!Buffer::HasInstance(buffer)) {
+            return Nan::ThrowError("wrong buffer type");
+        }
+        iov[i].iov_base = Buffer::Data(buffer);
+        iov[i].iov_len = Buffer::Length(buffer);
+    }
+    ssize_t written = 0;
+    if (count) {
+        TERMIOS_CALL(STAT_WRITEV, written = writev(int32_arg(info[0]), &iov[0], count));
+    }
+    info.GetReturnValue().Set(Nan::New<Number>(written == -1 ? -errno : written));
+}
+
+
 NAN_METHOD(Tcgetattr)
 {
-    Nan::HandleScope scope;
-    if (info.Length() != 2
-          || !info[0]->IsNumber()
-          || !info[1]->IsObject()) {
+    if (info.Length() != 2 || !info[0]->IsInt32()) {
         return Nan::ThrowError("Usage: tcgetattr(fd, buffer)");
     }
-    if (!Buffer::HasInstance(info[1]) || Buffer::Length(info[1]) != sizeof(struct termios)) {
+    struct termios *buf = termios_arg(info[1]);
+    if (!buf) {
         return Nan::ThrowError("wrong buffer type");
     }
-    struct termios* buf = (struct termios *) Buffer::Data(info[1]);
-
-    int res;
-    TEMP_FAILURE_RETRY(res = tcgetattr(Nan::To<int>(info[0]).FromJust(), buf));
-    if (res) {
+    int fd = int32_arg(info[0]);
+    if (termios_tcgetattr(fd, buf)) {
         std::string error(strerror(errno));
         return Nan::ThrowError((std::string("tcgetattr failed - ") + error).c_str());
     }
-    info.GetReturnValue().SetUndefined();
+    termios_cache_store(fd, buf);
 }
 
 
 NAN_METHOD(Tcsetattr)
 {
-    Nan::HandleScope scope;
+    if (info.Length() != 3 || !info[0]->IsInt32() || !info[1]->IsInt32()) {
+        return Nan::ThrowError("Usage: tcsetattr(fd, action, buffer)");
+    }
+    struct termios *buf = termios_arg(info[2]);
+    if (!buf) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    if (cached_tcsetattr(int32_arg(info[0]), int32_arg(info[1]), buf)) {
+        std::string error(strerror(errno));
+        return Nan::ThrowError((std::string("tcsetattr failed - ") + error).c_str());
+    }
+}
+
+
+/**
+ * Batch versions of tcgetattr / tcsetattr.
+ *
+ * `buffer` holds `struct termios` data for all fds back to back.
+ * Other than the single versions they do not throw on a failing fd,
+ * instead they return an array with 0 or the negative errno value for each fd.
+ */
+NAN_METHOD(TcgetattrMany)
+{
+    if (info.Length() != 2
+          || !info[0]->IsArray()
+          || !info[1]->IsObject()) {
+        return Nan::ThrowError("Usage: tcgetattr_many(fds, buffer)");
+    }
+    Local<Array> fds = info[0].As<Array>();
+    uint32_t count = fds->Length();
+    if (!Buffer::HasInstance(info[1]) || Buffer::Length(info[1]) != count * sizeof(struct termios)) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    struct termios *buf = (struct termios *) Buffer::Data(info[1]);
+
+    Local<Array> result = Nan::New<Array>(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        int fd = Nan::To<int>(Nan::Get(fds, i).ToLocalChecked()).FromMaybe(-1);
+        if (fd < 0) {
+            // skipped slot, no syscall
+            Nan::Set(result, i, Nan::New<Number>(-EBADF));
+            continue;
+        }
+        int res = termios_tcgetattr(fd, buf + i);
+        if (!res) {
+            termios_cache_store(fd, buf + i);
+        }
+        Nan::Set(result, i, Nan::New<Number>((res) ? -errno : 0));
+    }
+    info.GetReturnValue().Set(result);
+}
+
+
+NAN_METHOD(TcsetattrMany)
+{
     if (info.Length() != 3
-          || !info[0]->IsNumber()
+          || !info[0]->IsArray()
           || !info[1]->IsNumber()
           || !info[2]->IsObject()) {
-        return Nan::ThrowError("Usage: tcsetattr(fd, action, buffer)");
+        return Nan::ThrowError("Usage: tcsetattr_many(fds, action, buffer)");
     }
-
-    if (!Buffer::HasInstance(info[2]) || Buffer::Length(info[2]) != sizeof(struct termios)) {
+    Local<Array> fds = info[0].As<Array>();
+    uint32_t count = fds->Length();
+    if (!Buffer::HasInstance(info[2]) || Buffer::Length(info[2]) != count * sizeof(struct termios)) {
         return Nan::ThrowError("wrong buffer type");
     }
     struct termios *buf = (struct termios *) Buffer::Data(info[2]);
-
-    int res;
-    TEMP_FAILURE_RETRY(res = tcsetattr(Nan::To<int>(info[0]).FromJust(), Nan::To<int>(info[1]).FromJust(), buf));
-    if (res) {
-        std::string error(strerror(errno));
-        return Nan::ThrowError((std::string("tcsetattr failed - ") + error).c_str());
+    int action = Nan::To<int>(info[1]).FromJust();
+
+    Local<Array> result = Nan::New<Array>(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        int fd = Nan::To<int>(Nan::Get(fds, i).ToLocalChecked()).FromMaybe(-1);
+        if (fd < 0) {
+            Nan::Set(result, i, Nan::New<Number>(-EBADF));
+            continue;
+        }
+        int res = cached_tcsetattr(fd, action, buf + i);
+        Nan::Set(result, i, Nan::New<Number>((res) ? -errno : 0));
     }
-    info.GetReturnValue().SetUndefined();
+    info.GetReturnValue().Set(result);
 }
 
 
 NAN_METHOD(Tcsendbreak)
 {
-    Nan::HandleScope scope;
     if (info.Length() != 2
           || !info[0]->IsNumber()
           || !info[1]->IsNumber()) {
         return Nan::ThrowError("usage: termios.tcsendbreak(fd, duration)");
     }
     int res;
-    TEMP_FAILURE_RETRY(res = tcsendbreak(Nan::To<int>(info[0]).FromJust(), Nan::To<int>(info[1]).FromJust()));
+    TERMIOS_CALL(STAT_TCSENDBREAK, res = tcsendbreak(Nan::To<int>(info[0]).FromJust(), Nan::To<int>(info[1]).FromJust()));
     if (res) {
         std::string error(strerror(errno));
         return Nan::ThrowError((std::string("tcsendbreak failed - ") + error).c_str());
@@ -190,12 +415,11 @@ NAN_METHOD(Tcsendbreak)
 
 NAN_METHOD(Tcdrain)
 {
-    Nan::HandleScope scope;
     if (info.Length() != 1 || !info[0]->IsNumber()) {
         return Nan::ThrowError("usage: termios.tcdrain(fd)");
     }
     int res;
-    TEMP_FAILURE_RETRY(res = tcdrain(Nan::To<int>(info[0]).FromJust()));
+    TERMIOS_CALL(STAT_TCDRAIN, res = tcdrain(Nan::To<int>(info[0]).FromJust()));
     if (res) {
         std::string error(strerror(errno));
         return Nan::ThrowError((std::string("tcdrain failed - ") + error).c_str());
@@ -206,14 +430,13 @@ NAN_METHOD(Tcdrain)
 
 NAN_METHOD(Tcflush)
 {
-    Nan::HandleScope scope;
     if (info.Length() != 2
           || !info[0]->IsNumber()
           || !info[1]->IsNumber()) {
         return Nan::ThrowError("usage: termios.tcflush(fd, queue_selector)");
     }
     int res;
-    TEMP_FAILURE_RETRY(res = tcflush(Nan::To<int>(info[0]).FromJust(), Nan::To<int>(info[1]).FromJust()));
+    TERMIOS_CALL(STAT_TCFLUSH, res = tcflush(Nan::To<int>(info[0]).FromJust(), Nan::To<int>(info[1]).FromJust()));
     if (res) {
         std::string error(strerror(errno));
         return Nan::ThrowError((std::string("tcflush failed - ") + error).c_str());
@@ -224,14 +447,13 @@ NAN_METHOD(Tcflush)
 
 NAN_METHOD(Tcflow)
 {
-    Nan::HandleScope scope;
     if (info.Length() != 2
           || !info[0]->IsNumber()
           || !info[1]->IsNumber()) {
         return Nan::ThrowError("usage: termios.tcflow(fd, action)");
     }
     int res;
-    TEMP_FAILURE_RETRY(res = tcflow(Nan::To<int>(info[0]).FromJust(), Nan::To<int>(info[1]).FromJust()));
+    TERMIOS_CALL(STAT_TCFLOW, res = tcflow(Nan::To<int>(info[0]).FromJust(), Nan::To<int>(info[1]).FromJust()));
     if (res) {
         std::string error(strerror(errno));
         return Nan::ThrowError((std::string("tcflow failed - ") + error).c_str());
@@ -242,71 +464,59 @@ NAN_METHOD(Tcflow)
 
 NAN_METHOD(Cfgetispeed)
 {
-    Nan::HandleScope scope;
-    if (info.Length() != 1
-          || !info[0]->IsObject()) {
+    if (info.Length() != 1) {
         return Nan::ThrowError("usage: termios.cfgetispeed(buffer)");
     }
-    if (!Buffer::HasInstance(info[0]) || Buffer::Length(info[0]) != sizeof(struct termios)) {
+    struct termios *buf = termios_arg(info[0]);
+    if (!buf) {
         return Nan::ThrowError("wrong buffer type");
     }
-    struct termios *buf = (struct termios *) Buffer::Data(info[0]);
     info.GetReturnValue().Set(Nan::New<Number>(cfgetispeed(buf)));
 }
 
 
 NAN_METHOD(Cfgetospeed)
 {
-    Nan::HandleScope scope;
-    if (info.Length() != 1
-          || !info[0]->IsObject()) {
+    if (info.Length() != 1) {
         return Nan::ThrowError("usage: termios.cfgetospeed(buffer)");
     }
-    if (!Buffer::HasInstance(info[0]) || Buffer::Length(info[0]) != sizeof(struct termios)) {
+    struct termios *buf = termios_arg(info[0]);
+    if (!buf) {
         return Nan::ThrowError("wrong buffer type");
     }
-    struct termios *buf = (struct termios *) Buffer::Data(info[0]);
     info.GetReturnValue().Set(Nan::New<Number>(cfgetospeed(buf)));
 }
 
 
 NAN_METHOD(Cfsetispeed)
 {
-    Nan::HandleScope scope;
-    if (info.Length() != 2
-          || !info[0]->IsObject()
-          || !info[1]->IsNumber()) {
+    if (info.Length() != 2 || !info[1]->IsInt32()) {
         return Nan::ThrowError("usage: termios.cfsetispeed(buffer, speed)");
     }
-    if (!Buffer::HasInstance(info[0]) || Buffer::Length(info[0]) != sizeof(struct termios)) {
+    struct termios *buf = termios_arg(info[0]);
+    if (!buf) {
         return Nan::ThrowError("wrong buffer type");
     }
-    struct termios *buf = (struct termios *) Buffer::Data(info[0]);
-    if (cfsetispeed(buf, Nan::To<int>(info[1]).FromJust())) {
+    if (cfsetispeed(buf, int32_arg(info[1]))) {
         std::string error(strerror(errno));
         return Nan::ThrowError((std::string("cfsetispeed failed - ") + error).c_str());
     }
-    info.GetReturnValue().SetUndefined();
 }
 
 
 NAN_METHOD(Cfsetospeed)
 {
-    Nan::HandleScope scope;
-    if (info.Length() != 2
-          || !info[0]->IsObject()
-          || !info[1]->IsNumber()) {
+    if (info.Length() != 2 || !info[1]->IsInt32()) {
         return Nan::ThrowError("usage: termios.cfsetospeed(buffer, speed)");
     }
-    if (!Buffer::HasInstance(info[0]) || Buffer::Length(info[0]) != sizeof(struct termios)) {
+    struct termios *buf = termios_arg(info[0]);
+    if (!buf) {
         return Nan::ThrowError("wrong buffer type");
     }
-    struct termios *buf = (struct termios *) Buffer::Data(info[0]);
-    if (cfsetospeed(buf, Nan::To<int>(info[1]).FromJust())) {
+    if (cfsetospeed(buf, int32_arg(info[1]))) {
         std::string error(strerror(errno));
         return Nan::ThrowError((std::string("cfsetospeed failed - ") + error).c_str());
     }
-    info.GetReturnValue().SetUndefined();
 }
 
 #if !defined(__sun) && !defined(__hpux) && !defined(_AIX)
@@ -316,7 +526,6 @@ NAN_METHOD(Cfsetospeed)
 
 NAN_METHOD(Load_ttydefaults)
 {
-    Nan::HandleScope scope;
     if (info.Length() != 1
           || !info[0]->IsObject()) {
         return Nan::ThrowError("Usage: load_ttydefaults(buffer)");
@@ -12,14 +12,28 @@
 #include <unistd.h>
 #include <stdlib.h>
 
+// resolve slave path of a pty master, returns 0 or an errno value
+int termios_ptsname(int fd, char *buf, size_t buflen);
+
+// device id and inode of the tty behind fd (pty masters resolve to their slave),
+// returns 0 or -1 with errno set
+int termios_tty_id(int fd, dev_t *dev, ino_t *ino);
+
 // helper function
 NAN_METHOD(Isatty);
 NAN_METHOD(Ttyname);
 NAN_METHOD(Ptsname);
+NAN_METHOD(Inq);
+NAN_METHOD(Outq);
+NAN_METHOD(InqMany);
+NAN_METHOD(OutqMany);
+NAN_METHOD(Writev);
 
 // termios functions
 NAN_METHOD(Tcgetattr);
 NAN_METHOD(Tcsetattr);
+NAN_METHOD(TcgetattrMany);
+NAN_METHOD(TcsetattrMany);
 NAN_METHOD(Tcsendbreak);
 NAN_METHOD(Tcdrain);
 NAN_METHOD(Tcflush);
@@ -0,0 +1,178 @@
+/* termios_cache.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "termios_cache.h"
+#include "termios_basic.h"
+#include "termios_snapshot.h"
+#include "termios_speed.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+
+struct CacheEntry {
+    dev_t dev;          // fd itself, detects fd reuse
+    ino_t ino;
+    dev_t tty_dev;      // tty behind the fd, shared by its aliases
+    ino_t tty_ino;
+    struct termios attrs;
+};
+
+static std::atomic<bool> cache_enabled(false);
+static std::atomic<uint64_t> cache_hits(0);
+static std::atomic<uint64_t> cache_misses(0);
+static std::mutex cache_mutex;
+static std::unordered_map<int, CacheEntry> cache;
+
+
+static bool identify(int fd, dev_t *dev, ino_t *ino)
+{
+    struct stat st;
+    if (fstat(fd, &st)) {
+        return false;
+    }
+    *dev = st.st_dev;
+    *ino = st.st_ino;
+    return true;
+}
+
+
+/**
+ * Store `attrs` as state of the tty behind fd. Other fds on the same tty
+ * see the new state as well, their entries get updated.
+ */
+static void store_entry(int fd, dev_t dev, ino_t ino, const struct termios *attrs)
+{
+    dev_t tty_dev;
+    ino_t tty_ino;
+    bool identified = !termios_tty_id(fd, &tty_dev, &tty_ino);
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (!identified) {
+        cache.erase(fd);
+        return;
+    }
+    for (auto &it : cache) {
+        if (it.second.tty_dev == tty_dev && it.second.tty_ino == tty_ino) {
+            memcpy(&it.second.attrs, attrs, sizeof(struct termios));
+        }
+    }
+    CacheEntry &entry = cache[fd];
+    entry.dev = dev;
+    entry.ino = ino;
+    entry.tty_dev = tty_dev;
+    entry.tty_ino = tty_ino;
+    memcpy(&entry.attrs, attrs, sizeof(struct termios));
+}
+
+
+int cached_tcsetattr(int fd, int action, const struct termios *attrs)
+{
+    snapshot_note(fd);
+    if (!cache_enabled.load(std::memory_order_relaxed)) {
+        return termios_tcsetattr(fd, action, attrs);
+    }
+    dev_t dev;
+    ino_t ino;
+    bool known = identify(fd, &dev, &ino);
+    if (known) {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = cache.find(fd);
+        if (it != cache.end()
+              && it->second.dev == dev
+              && it->second.ino == ino
+              && !memcmp(&it->second.attrs, attrs, sizeof(struct termios))) {
+            cache_hits++;
+            return 0;
+        }
+    }
+    cache_misses++;
+    int res = termios_tcsetattr(fd, action, attrs);
+    if (!res && known) {
+        store_entry(fd, dev, ino, attrs);
+    } else {
+        int err = errno;
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        cache.erase(fd);
+        errno = err;
+    }
+    return res;
+}
+
+
+void termios_cache_store(int fd, const struct termios *attrs)
+{
+    if (!cache_enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    dev_t dev;
+    ino_t ino;
+    if (identify(fd, &dev, &ino)) {
+        store_entry(fd, dev, ino, attrs);
+    }
+}
+
+
+NAN_METHOD(CacheEnable)
+{
+    if (info.Length() != 1 || !info[0]->IsBoolean()) {
+        return Nan::ThrowError("usage: termios.cache_enable(enable)");
+    }
+    bool enable = Nan::To<bool>(info[0]).FromJust();
+    if (!enable) {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        cache.clear();
+    }
+    cache_enabled = enable;
+    info.GetReturnValue().SetUndefined();
+}
+
+
+NAN_METHOD(CacheInvalidate)
+{
+    if (info.Length() > 1 || (info.Length() == 1 && !info[0]->IsNumber())) {
+        return Nan::ThrowError("usage: termios.cache_invalidate(fd?)");
+    }
+    if (!info.Length()) {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        cache.clear();
+        return info.GetReturnValue().SetUndefined();
+    }
+    // drop all fds on the same tty
+    int fd = Nan::To<int>(info[0]).FromJust();
+    dev_t tty_dev;
+    ino_t tty_ino;
+    bool known = !termios_tty_id(fd, &tty_dev, &tty_ino);
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    cache.erase(fd);
+    for (auto it = cache.begin(); known && it != cache.end();) {
+        if (it->second.tty_dev == tty_dev && it->second.tty_ino == tty_ino) {
+            it = cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    info.GetReturnValue().SetUndefined();
+}
+
+
+NAN_METHOD(CacheStats)
+{
+    size_t entries;
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        entries = cache.size();
+    }
+    Local<Object> stats = Nan::New<Object>();
+    Nan::Set(stats, Nan::New<String>("enabled").ToLocalChecked(), Nan::New<Boolean>(cache_enabled.load()));
+    Nan::Set(stats, Nan::New<String>("hits").ToLocalChecked(), Nan::New<Number>((double) cache_hits.load()));
+    Nan::Set(stats, Nan::New<String>("misses").ToLocalChecked(), Nan::New<Number>((double) cache_misses.load()));
+    Nan::Set(stats, Nan::New<String>("entries").ToLocalChecked(), Nan::New<Number>((double) entries));
+    info.GetReturnValue().Set(stats);
+}
@@ -0,0 +1,35 @@
+/* termios_cache.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TERMIOS_CACHE_H
+#define TERMIOS_CACHE_H
+
+#include "node_termios.h"
+
+/**
+ * Opt-in cache of the last termios state applied to an fd.
+ *
+ * Entries are keyed by fd and validated by device/inode to survive fd reuse.
+ * Termios settings belong to the tty, thus every store also updates the
+ * entries of other fds on the same tty (see termios_tty_id, both ends of
+ * a pty count as one tty). If enabled, `cached_tcsetattr` skips the syscall
+ * for data equal to the cached state. The cache is process wide (shared by
+ * worker threads) and only knows about changes made through this module,
+ * use `cache_invalidate` if other parties might alter the settings.
+ */
+
+// tcsetattr replacement, returns 0 or -1 with errno set
+int cached_tcsetattr(int fd, int action, const struct termios *attrs);
+
+// update cache with data just read by tcgetattr
+void termios_cache_store(int fd, const struct termios *attrs);
+
+NAN_METHOD(CacheEnable);
+NAN_METHOD(CacheInvalidate);
+NAN_METHOD(CacheStats);
+
+#endif // TERMIOS_CACHE_H
@@ -0,0 +1,122 @@
+/* termios_parmrk.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "termios_parmrk.h"
+#include <string.h>
+
+
+long parmrk_decode(const uint8_t *in, size_t len, uint8_t *out,
+                   uint32_t *state, uint32_t *errors, size_t capacity)
+{
+    const uint8_t *p = in;
+    const uint8_t *end = in + len;
+    uint8_t *o = out;
+    uint32_t carry = state[PARMRK_CARRY];
+    size_t count = 0;
+    state[PARMRK_ERRORS] = 0;
+
+    // memchr is vectorized by the libc, most chunks end here
+    const uint8_t *marker = NULL;
+    if (!carry) {
+        marker = (const uint8_t *) memchr(p, 0xFF, len);
+        if (!marker) {
+            state[PARMRK_BYTES] += len;
+            return -1;
+        }
+    }
+
+    while (p < end) {
+        if (!carry) {
+            if (!marker) {
+                marker = (const uint8_t *) memchr(p, 0xFF, end - p);
+            }
+            if (!marker) {
+                memcpy(o, p, end - p);
+                o += end - p;
+                break;
+            }
+            memcpy(o, p, marker - p);
+            o += marker - p;
+            p = marker + 1;
+            marker = NULL;
+            carry = 1;
+            continue;
+        }
+        uint8_t c = *p++;
+        if (carry == 1) {
+            if (c == 0xFF) {
+                *o++ = 0xFF;
+                state[PARMRK_ESCAPED]++;
+                carry = 0;
+            } else if (c == 0) {
+                carry = 2;
+            } else {
+                // stray \377 (PARMRK enabled midstream) - keep it
+                *o++ = 0xFF;
+                --p;
+                carry = 0;
+            }
+            continue;
+        }
+        // \377 \0 X - a break looks like an error on a NUL byte
+        uint32_t kind = c ? PARMRK_ERROR : PARMRK_BREAK;
+        state[kind == PARMRK_ERROR ? PARMRK_PARITY : PARMRK_BREAKS]++;
+        if (count < capacity) {
+            errors[count * 3] = (uint32_t) (o - out);
+            errors[count * 3 + 1] = kind;
+            errors[count * 3 + 2] = c;
+            count++;
+        } else {
+            state[PARMRK_DROPPED]++;
+        }
+        carry = 0;
+    }
+    state[PARMRK_CARRY] = carry;
+    state[PARMRK_ERRORS] = count;
+    state[PARMRK_BYTES] += o - out;
+    return o - out;
+}
+
+
+/**
+ * Decode a chunk of PARMRK marked input.
+ * Returns -1 if `input` has no markers (use it as it is, zero copy), or the
+ * payload length written to `output` (at least input.length + 1 bytes).
+ * Terminal settings without PARMRK (or with IGNPAR) pass the input through.
+ */
+NAN_METHOD(ParmrkDecode)
+{
+    if (info.Length() != 5 || !Buffer::HasInstance(info[1]) || !Buffer::HasInstance(info[2])) {
+        return Nan::ThrowError("usage: termios.parmrk_decode(buffer, input, output, state, errors)");
+    }
+    const struct termios *attrs = termios_arg(info[0]);
+    if (!attrs || !info[3]->IsUint32Array() || !info[4]->IsUint32Array()) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    Nan::TypedArrayContents<uint32_t> state_contents(info[3]);
+    Nan::TypedArrayContents<uint32_t> errors_contents(info[4]);
+    if (state_contents.length() < PARMRK_STATE_SIZE) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    uint32_t *state = *state_contents;
+    uint32_t *errors = *errors_contents;
+    size_t errors_length = errors_contents.length();
+    size_t len = Buffer::Length(info[1]);
+    if (!(attrs->c_iflag & PARMRK) || (attrs->c_iflag & IGNPAR)) {
+        state[PARMRK_ERRORS] = 0;
+        state[PARMRK_BYTES] += len;
+        info.GetReturnValue().Set(-1);
+        return;
+    }
+    // a carried stray \377 gets written in front of the chunk
+    if (Buffer::Length(info[2]) < len + (state[PARMRK_CARRY] ? 1 : 0)) {
+        return Nan::ThrowError("parmrk_decode failed - output too small");
+    }
+    long result = parmrk_decode((const uint8_t *) Buffer::Data(info[1]), len, (uint8_t *) Buffer::Data(info[2]),
+                                state, errors, errors_length / 3);
+    info.GetReturnValue().Set((double) result);
+}
@@ -0,0 +1,41 @@
+/* termios_parmrk.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TERMIOS_PARMRK_H
+#define TERMIOS_PARMRK_H
+
+#include "node_termios.h"
+#include <stdint.h>
+
+// error kinds
+#define PARMRK_ERROR 1  // parity or framing error, \377 \0 X
+#define PARMRK_BREAK 2  // break condition, \377 \0 \0
+
+/**
+ * Decoder state (Uint32Array words), carried across chunks.
+ */
+#define PARMRK_CARRY 0      // 0: none, 1: seen \377, 2: seen \377 \0
+#define PARMRK_ERRORS 1     // error records written by the last call
+#define PARMRK_DROPPED 2    // error records not fitting into the side channel (total)
+#define PARMRK_BYTES 3      // payload bytes (total)
+#define PARMRK_PARITY 4     // parity / framing errors (total)
+#define PARMRK_BREAKS 5     // breaks (total)
+#define PARMRK_ESCAPED 6    // literal \377 (total)
+#define PARMRK_STATE_SIZE 8
+
+/**
+ * Decode PARMRK marked input from `in` to `out` (at least len bytes).
+ * Error records (payload offset, kind, byte) are written as triples to
+ * `errors` (capacity in records). Returns the payload length
+ * or -1 if `in` contains no markers and can be used as it is.
+ */
+long parmrk_decode(const uint8_t *in, size_t len, uint8_t *out,
+                   uint32_t *state, uint32_t *errors, size_t capacity);
+
+NAN_METHOD(ParmrkDecode);
+
+#endif // TERMIOS_PARMRK_H
@@ -0,0 +1,213 @@
+/* termios_pty.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "termios_pty.h"
+#include "termios_basic.h"
+#include "termios_speed.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#ifdef SOLARIS
+#include <stropts.h>
+#endif
+#include <vector>
+
+
+struct PtyPair {
+    int master;
+    int slave;
+    char path[CUSTOM_MAX_TTY_PATH];
+};
+
+
+#ifndef __linux__
+static int set_fd_flags(int fd, bool nonblock)
+{
+    int flags = fcntl(fd, F_GETFD);
+    if (flags == -1 || fcntl(fd, F_SETFD, flags | FD_CLOEXEC) == -1) {
+        return -1;
+    }
+    if (nonblock) {
+        flags = fcntl(fd, F_GETFL);
+        if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+#endif
+
+
+/**
+ * Open a single pty pair.
+ *
+ * The master end is nonblocking, both ends are close-on-exec and
+ * the slave is opened without becoming the controlling terminal.
+ * `attrs` and `ws` get applied to the slave before the fds are handed out.
+ * Returns 0 or an errno value, nothing is left open on failure.
+ */
+static int open_pair(PtyPair *pair, const struct termios *attrs, const struct winsize *ws)
+{
+    pair->master = -1;
+    pair->slave = -1;
+    pair->path[0] = 0;
+
+    #ifdef __linux__
+    // linux accepts the flags directly, which avoids a cloexec race with fork
+    pair->master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    #else
+    pair->master = posix_openpt(O_RDWR | O_NOCTTY);
+    #endif
+    if (pair->master == -1) {
+        return errno;
+    }
+    int err = 0;
+    #ifndef __linux__
+    if (set_fd_flags(pair->master, true)) {
+        goto fail;
+    }
+    #endif
+    if (grantpt(pair->master) || unlockpt(pair->master)) {
+        goto fail;
+    }
+    err = termios_ptsname(pair->master, pair->path, CUSTOM_MAX_TTY_PATH);
+    if (err) {
+        goto fail;
+    }
+    TEMP_FAILURE_RETRY(pair->slave = open(pair->path, O_RDWR | O_NOCTTY | O_CLOEXEC));
+    if (pair->slave == -1) {
+        goto fail;
+    }
+    #ifdef SOLARIS
+    // load terminal semantics onto the slave stream
+    if (ioctl(pair->slave, I_PUSH, "ptem") == -1 || ioctl(pair->slave, I_PUSH, "ldterm") == -1) {
+        goto fail;
+    }
+    #endif
+    if (attrs && termios_tcsetattr(pair->slave, TCSANOW, attrs)) {
+        goto fail;
+    }
+    if (ws && ioctl(pair->slave, TIOCSWINSZ, ws) == -1) {
+        goto fail;
+    }
+    return 0;
+
+fail:
+    if (!err) {
+        err = errno;
+    }
+    close(pair->master);
+    if (pair->slave != -1) {
+        close(pair->slave);
+    }
+    pair->master = -1;
+    pair->slave = -1;
+    return err;
+}
+
+
+// upper bound of pairs per call, each pair takes 2 fds
+static int max_pairs()
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) || limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur > 0xffff * 2) {
+        return 0xffff;
+    }
+    return (int) (limit.rlim_cur / 2);
+}
+
+
+static int get_int(Local<Object> obj, const char *name, int fallback)
+{
+    Local<Value> value = Nan::Get(obj, Nan::New<String>(name).ToLocalChecked()).ToLocalChecked();
+    return (value->IsNumber()) ? Nan::To<int>(value).FromJust() : fallback;
+}
+
+
+NAN_METHOD(Openpty)
+{
+    if (info.Length() > 1 || (info.Length() == 1 && !info[0]->IsObject() && !info[0]->IsUndefined())) {
+        return Nan::ThrowError("usage: termios.openpty({count, winsize, termios})");
+    }
+    int count = 1;
+    struct termios *attrs = NULL;
+    struct winsize ws;
+    struct winsize *wsp = NULL;
+    if (info.Length() == 1 && info[0]->IsObject()) {
+        Local<Object> options = info[0].As<Object>();
+        count = get_int(options, "count", 1);
+        int max_count = max_pairs();
+        if (count < 1 || count > max_count) {
+            return Nan::ThrowError((std::string("usage: termios.openpty({count, winsize, termios}) - count must be 1..")
+                + std::to_string(max_count)).c_str());
+        }
+        Local<Value> buffer = Nan::Get(options, Nan::New<String>("termios").ToLocalChecked()).ToLocalChecked();
+        if (!buffer->IsUndefined() && !buffer->IsNull()) {
+            if (!Buffer::HasInstance(buffer) || Buffer::Length(buffer) != sizeof(struct termios)) {
+                return Nan::ThrowError("wrong buffer type");
+            }
+            attrs = (struct termios *) Buffer::Data(buffer);
+        }
+        Local<Value> size = Nan::Get(options, Nan::New<String>("winsize").ToLocalChecked()).ToLocalChecked();
+        if (size->IsObject()) {
+            Local<Object> size_obj = size.As<Object>();
+            memset(&ws, 0, sizeof(ws));
+            ws.ws_row = get_int(size_obj, "rows", 24);
+            ws.ws_col = get_int(size_obj, "cols", 80);
+            ws.ws_xpixel = get_int(size_obj, "xpixel", 0);
+            ws.ws_ypixel = get_int(size_obj, "ypixel", 0);
+            wsp = &ws;
+        }
+    }
+
+    std::vector<PtyPair> pairs(count);
+    for (int i = 0; i < count; ++i) {
+        int err = open_pair(&pairs[i], attrs, wsp);
+        if (err) {
+            // all or nothing
+            for (int j = 0; j < i; ++j) {
+                close(pairs[j].master);
+                close(pairs[j].slave);
+            }
+            std::string error(strerror(err));
+            return Nan::ThrowError((std::string("openpty failed - ") + error).c_str());
+        }
+    }
+
+    Local<Array> result = Nan::New<Array>(count);
+    for (int i = 0; i < count; ++i) {
+        Local<Object> pair = Nan::New<Object>();
+        Nan::Set(pair, Nan::New<String>("master").ToLocalChecked(), Nan::New<Number>(pairs[i].master));
+        Nan::Set(pair, Nan::New<String>("slave").ToLocalChecked(), Nan::New<Number>(pairs[i].slave));
+        Nan::Set(pair, Nan::New<String>("path").ToLocalChecked(), Nan::New<String>(pairs[i].path).ToLocalChecked());
+        Nan::Set(result, i, pair);
+    }
+    info.GetReturnValue().Set(result);
+}
+
+
+NAN_METHOD(PacketMode)
+{
+    if (info.Length() != 2 || !info[0]->IsNumber() || !info[1]->IsBoolean()) {
+        return Nan::ThrowError("usage: termios.packet_mode(fd, enable)");
+    }
+    #ifdef TIOCPKT
+    int enable = Nan::To<bool>(info[1]).FromJust();
+    int res;
+    TEMP_FAILURE_RETRY(res = ioctl(Nan::To<int>(info[0]).FromJust(), TIOCPKT, &enable));
+    if (res) {
+        std::string error(strerror(errno));
+        return Nan::ThrowError((std::string("packet_mode failed - ") + error).c_str());
+    }
+    #else
+    return Nan::ThrowError("packet_mode failed - not supported");
+    #endif
+    info.GetReturnValue().SetUndefined();
+}
@@ -0,0 +1,19 @@
+/* termios_pty.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TERMIOS_PTY_H
+#define TERMIOS_PTY_H
+
+#include "node_termios.h"
+
+// allocate pty master/slave pairs
+NAN_METHOD(Openpty);
+
+// switch pty master to packet mode (TIOCPKT)
+NAN_METHOD(PacketMode);
+
+#endif // TERMIOS_PTY_H
@@ -0,0 +1,186 @@
+/* termios_raw.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "termios_raw.h"
+#include "termios_cache.h"
+#include "termios_speed.h"
+#include "termios_stats.h"
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+
+
+struct ErrnoEntry {
+    const char *name;
+    int value;
+};
+
+#define ERRNO_ENTRY(name) {#name, name}
+
+// errno values likely to show up with ttys, first entry wins for aliases
+static const ErrnoEntry errno_table[] = {
+    ERRNO_ENTRY(EPERM),
+    ERRNO_ENTRY(ENOENT),
+    ERRNO_ENTRY(EINTR),
+    ERRNO_ENTRY(EIO),
+    ERRNO_ENTRY(ENXIO),
+    ERRNO_ENTRY(EBADF),
+    ERRNO_ENTRY(EAGAIN),
+    ERRNO_ENTRY(EWOULDBLOCK),
+    ERRNO_ENTRY(ENOMEM),
+    ERRNO_ENTRY(EACCES),
+    ERRNO_ENTRY(EFAULT),
+    ERRNO_ENTRY(EBUSY),
+    ERRNO_ENTRY(ENODEV),
+    ERRNO_ENTRY(EINVAL),
+    ERRNO_ENTRY(EMFILE),
+    ERRNO_ENTRY(ENFILE),
+    ERRNO_ENTRY(ENOTTY),
+    ERRNO_ENTRY(ENOSPC),
+    ERRNO_ENTRY(EPIPE),
+    ERRNO_ENTRY(ERANGE),
+    ERRNO_ENTRY(ENOSYS),
+    ERRNO_ENTRY(ENOTSUP),
+    #ifdef EOPNOTSUPP
+    ERRNO_ENTRY(EOPNOTSUPP),
+    #endif
+    ERRNO_ENTRY(ETIMEDOUT),
+    ERRNO_ENTRY(ECANCELED),
+    #ifdef ENOLINK
+    ERRNO_ENTRY(ENOLINK),
+    #endif
+    #ifdef EHOSTDOWN
+    ERRNO_ENTRY(EHOSTDOWN),
+    #endif
+    {NULL, 0}
+};
+
+
+const char *termios_errname(int code)
+{
+    if (code < 0) {
+        code = -code;
+    }
+    for (const ErrnoEntry *entry = errno_table; entry->name; ++entry) {
+        if (entry->value == code) {
+            return entry->name;
+        }
+    }
+    return NULL;
+}
+
+
+static NAN_METHOD(RawIsatty)
+{
+    if (info.Length() != 1 || !info[0]->IsInt32()) {
+        return info.GetReturnValue().Set(-EINVAL);
+    }
+    errno = 0;
+    int tty = isatty(int32_arg(info[0]));
+    info.GetReturnValue().Set((!tty && errno == EBADF) ? -EBADF : tty);
+}
+
+
+static NAN_METHOD(RawTcgetattr)
+{
+    struct termios *buf;
+    if (info.Length() != 2 || !info[0]->IsInt32() || !(buf = termios_arg(info[1]))) {
+        return info.GetReturnValue().Set(-EINVAL);
+    }
+    int fd = int32_arg(info[0]);
+    if (termios_tcgetattr(fd, buf)) {
+        return info.GetReturnValue().Set(-errno);
+    }
+    termios_cache_store(fd, buf);
+    info.GetReturnValue().Set(0);
+}
+
+
+static NAN_METHOD(RawTcsetattr)
+{
+    struct termios *buf;
+    if (info.Length() != 3 || !info[0]->IsInt32() || !info[1]->IsInt32()
+          || !(buf = termios_arg(info[2]))) {
+        return info.GetReturnValue().Set(-EINVAL);
+    }
+    int res = cached_tcsetattr(int32_arg(info[0]), int32_arg(info[1]), buf);
+    info.GetReturnValue().Set((res) ? -errno : 0);
+}
+
+
+static NAN_METHOD(RawTcflush)
+{
+    if (info.Length() != 2 || !info[0]->IsInt32() || !info[1]->IsInt32()) {
+        return info.GetReturnValue().Set(-EINVAL);
+    }
+    int res;
+    TERMIOS_CALL(STAT_TCFLUSH, res = tcflush(int32_arg(info[0]), int32_arg(info[1])));
+    info.GetReturnValue().Set((res) ? -errno : 0);
+}
+
+
+static NAN_METHOD(RawTcflow)
+{
+    if (info.Length() != 2 || !info[0]->IsInt32() || !info[1]->IsInt32()) {
+        return info.GetReturnValue().Set(-EINVAL);
+    }
+    int res;
+    TERMIOS_CALL(STAT_TCFLOW, res = tcflow(int32_arg(info[0]), int32_arg(info[1])));
+    info.GetReturnValue().Set((res) ? -errno : 0);
+}
+
+
+static NAN_METHOD(RawTcdrain)
+{
+    if (info.Length() != 1 || !info[0]->IsInt32()) {
+        return info.GetReturnValue().Set(-EINVAL);
+    }
+    int res;
+    TERMIOS_CALL(STAT_TCDRAIN, res = tcdrain(int32_arg(info[0])));
+    info.GetReturnValue().Set((res) ? -errno : 0);
+}
+
+
+static NAN_METHOD(RawErrname)
+{
+    const char *name = (info.Length() == 1 && info[0]->IsInt32())
+        ? termios_errname(int32_arg(info[0]))
+        : NULL;
+    info.GetReturnValue().Set(
+        (name) ? Nan::New<String>(name).ToLocalChecked() : Nan::EmptyString());
+}
+
+
+static NAN_METHOD(RawStrerror)
+{
+    if (info.Length() != 1 || !info[0]->IsInt32()) {
+        return Nan::ThrowError("usage: termios.raw.strerror(code)");
+    }
+    int code = int32_arg(info[0]);
+    info.GetReturnValue().Set(Nan::New<String>(strerror((code < 0) ? -code : code)).ToLocalChecked());
+}
+
+
+NAN_MODULE_INIT(InitRaw)
+{
+    Local<Object> raw = Nan::New<Object>();
+    Nan::SetMethod(raw, "isatty", RawIsatty);
+    Nan::SetMethod(raw, "tcgetattr", RawTcgetattr);
+    Nan::SetMethod(raw, "tcsetattr", RawTcsetattr);
+    Nan::SetMethod(raw, "tcflush", RawTcflush);
+    Nan::SetMethod(raw, "tcflow", RawTcflow);
+    Nan::SetMethod(raw, "tcdrain", RawTcdrain);
+    Nan::SetMethod(raw, "errname", RawErrname);
+    Nan::SetMethod(raw, "strerror", RawStrerror);
+    MODULE_EXPORT("raw", raw);
+
+    Local<Object> errnos = Nan::New<Object>();
+    for (const ErrnoEntry *entry = errno_table; entry->name; ++entry) {
+        Nan::Set(errnos, Nan::New<String>(entry->name).ToLocalChecked(), Nan::New<Number>(entry->value));
+    }
+    MODULE_EXPORT("ERRNO", errnos);
+}
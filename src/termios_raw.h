@@ -0,0 +1,25 @@
+/* termios_raw.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TERMIOS_RAW_H
+#define TERMIOS_RAW_H
+
+#include "node_termios.h"
+
+/**
+ * Non throwing variants of the basic functions for hot polling loops.
+ *
+ * They return 0 (isatty: 1/0) on success or a negative errno value,
+ * wrong arguments are reported as -EINVAL. Error messages are only
+ * built on request with `errname` / `strerror`.
+ */
+NAN_MODULE_INIT(InitRaw);
+
+// errno name lookup from the static table, NULL for unknown values
+const char *termios_errname(int code);
+
+#endif // TERMIOS_RAW_H
@@ -0,0 +1,155 @@
+/* termios_shared.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "termios_shared.h"
+#include "termios_cache.h"
+#include "termios_speed.h"
+#include <errno.h>
+#include <string.h>
+#include <sched.h>
+#include <stdint.h>
+#include <mutex>
+#include <unordered_map>
+
+
+// per-fd locks, never freed (bounded by the fd table size)
+static std::mutex fd_locks_mutex;
+static std::unordered_map<int, std::mutex *> fd_locks;
+
+
+static std::mutex *fd_lock(int fd)
+{
+    std::lock_guard<std::mutex> lock(fd_locks_mutex);
+    std::mutex *&entry = fd_locks[fd];
+    if (!entry) {
+        entry = new std::mutex;
+    }
+    return entry;
+}
+
+
+static void seq_write_begin(uint32_t *seq)
+{
+    for (;;) {
+        uint32_t current = __atomic_load_n(seq, __ATOMIC_RELAXED);
+        if (!(current & 1) && __atomic_compare_exchange_n(
+              seq, &current, current + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        sched_yield();
+    }
+}
+
+
+static void seq_write_end(uint32_t *seq)
+{
+    __atomic_fetch_add(seq, 1, __ATOMIC_RELEASE);
+}
+
+
+static void seq_read(const char *slot, struct termios *out)
+{
+    const uint32_t *seq = (const uint32_t *) slot;
+    for (;;) {
+        uint32_t before = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            sched_yield();
+            continue;
+        }
+        memcpy(out, slot + SHARED_HEADER, sizeof(struct termios));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(seq, __ATOMIC_RELAXED) == before) {
+            return;
+        }
+    }
+}
+
+
+static char *slot_arg(Local<Value> value)
+{
+    if (!Buffer::HasInstance(value) || Buffer::Length(value) != SHARED_HEADER + sizeof(struct termios)) {
+        return NULL;
+    }
+    char *slot = Buffer::Data(value);
+    // the sequence word is accessed atomically
+    return ((uintptr_t) slot & 3) ? NULL : slot;
+}
+
+
+NAN_METHOD(SharedLoad)
+{
+    char *slot;
+    if (info.Length() < 2 || info.Length() > 3 || !info[0]->IsInt32()
+          || (info.Length() == 3 && !info[2]->IsBoolean())) {
+        return Nan::ThrowError("usage: termios.shared_load(fd, slot, owned?)");
+    }
+    if (!(slot = slot_arg(info[1]))) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    int fd = int32_arg(info[0]);
+    bool owned = info.Length() == 3 && Nan::To<bool>(info[2]).FromJust();
+    struct termios attrs;
+    {
+        std::lock_guard<std::mutex> lock(*fd_lock(fd));
+        if (termios_tcgetattr(fd, &attrs)) {
+            std::string error(strerror(errno));
+            return Nan::ThrowError((std::string("tcgetattr failed - ") + error).c_str());
+        }
+        if (!owned) {
+            seq_write_begin((uint32_t *) slot);
+        }
+        memcpy(slot + SHARED_HEADER, &attrs, sizeof(struct termios));
+        if (!owned) {
+            seq_write_end((uint32_t *) slot);
+        }
+    }
+    termios_cache_store(fd, &attrs);
+}
+
+
+NAN_METHOD(SharedStore)
+{
+    char *slot;
+    if (info.Length() < 3 || info.Length() > 4 || !info[0]->IsInt32() || !info[1]->IsInt32()
+          || (info.Length() == 4 && !info[3]->IsBoolean())) {
+        return Nan::ThrowError("usage: termios.shared_store(fd, action, slot, owned?)");
+    }
+    if (!(slot = slot_arg(info[2]))) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    int fd = int32_arg(info[0]);
+    bool owned = info.Length() == 4 && Nan::To<bool>(info[3]).FromJust();
+    struct termios attrs;
+    int res;
+    {
+        std::lock_guard<std::mutex> lock(*fd_lock(fd));
+        if (owned) {
+            memcpy(&attrs, slot + SHARED_HEADER, sizeof(struct termios));
+        } else {
+            seq_read(slot, &attrs);
+        }
+        res = cached_tcsetattr(fd, int32_arg(info[1]), &attrs);
+    }
+    if (res) {
+        std::string error(strerror(errno));
+        return Nan::ThrowError((std::string("tcsetattr failed - ") + error).c_str());
+    }
+}
+
+
+NAN_METHOD(SharedSnapshot)
+{
+    char *slot;
+    struct termios *buf;
+    if (info.Length() != 2) {
+        return Nan::ThrowError("usage: termios.shared_snapshot(slot, buffer)");
+    }
+    if (!(slot = slot_arg(info[0])) || !(buf = termios_arg(info[1]))) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    seq_read(slot, buf);
+}
@@ -0,0 +1,32 @@
+/* termios_shared.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TERMIOS_SHARED_H
+#define TERMIOS_SHARED_H
+
+#include "node_termios.h"
+
+/**
+ * Termios data in shared memory (SharedArrayBuffer), used by several workers.
+ *
+ * A shared slot starts with a 32 bit sequence word (seqlock), followed by
+ * the termios data at offset SHARED_HEADER. Writers switch the sequence
+ * to odd with a CAS for the time of the update, readers retry until they
+ * copied the data with the same even sequence before and after.
+ * JS uses the same protocol with Atomics on an Int32Array.
+ *
+ * Syscalls on the same fd from shared slots are serialized by a
+ * process wide per-fd lock. With `owned` set the caller already is the
+ * writer of the slot (JS `update`), the data is accessed without the seqlock.
+ */
+#define SHARED_HEADER 8
+
+NAN_METHOD(SharedLoad);
+NAN_METHOD(SharedStore);
+NAN_METHOD(SharedSnapshot);
+
+#endif // TERMIOS_SHARED_H
@@ -0,0 +1,426 @@
+/* termios_snapshot.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "termios_snapshot.h"
+#include "termios_speed.h"
+#include "termios_winsize.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <mutex>
+
+
+static std::atomic<bool> store_active(false);
+static std::mutex store_mutex;
+static SnapshotHeader *store = nullptr;
+static size_t store_size = 0;
+
+
+static uint32_t record_size()
+{
+    return (uint32_t) (sizeof(SnapshotRecord) + ((sizeof(struct termios) + 7) & ~7));
+}
+
+
+static void init_header(SnapshotHeader *header, uint32_t capacity)
+{
+    memset(header, 0, sizeof(SnapshotHeader));
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header->version = SNAPSHOT_VERSION;
+    header->header_size = sizeof(SnapshotHeader);
+    header->record_size = record_size();
+    header->capacity = capacity;
+    header->termios_size = sizeof(struct termios);
+    header->flag_width = sizeof(tcflag_t);
+    header->iflag_offset = offsetof(struct termios, c_iflag);
+    header->oflag_offset = offsetof(struct termios, c_oflag);
+    header->cflag_offset = offsetof(struct termios, c_cflag);
+    header->lflag_offset = offsetof(struct termios, c_lflag);
+    header->cc_offset = offsetof(struct termios, c_cc);
+    header->cc_count = NCCS;
+}
+
+
+// whether records of header can be copied as they are
+static bool same_layout(const SnapshotHeader *header)
+{
+    SnapshotHeader own;
+    init_header(&own, header->capacity);
+    return header->record_size == own.record_size
+        && !memcmp(&header->termios_size, &own.termios_size,
+                   offsetof(SnapshotHeader, reserved) - offsetof(SnapshotHeader, termios_size));
+}
+
+
+// sanity check of a header found in a file of size bytes
+static bool valid_header(const SnapshotHeader *header, size_t size)
+{
+    if (size < sizeof(SnapshotHeader)
+          || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC))
+          || header->version != SNAPSHOT_VERSION
+          || header->header_size < sizeof(SnapshotHeader)
+          || header->record_size < sizeof(SnapshotRecord) + header->termios_size
+          || header->count > header->capacity
+          || (header->flag_width != 4 && header->flag_width != 8)) {
+        return false;
+    }
+    uint32_t offsets[] = {header->iflag_offset, header->oflag_offset, header->cflag_offset, header->lflag_offset};
+    for (uint32_t offset : offsets) {
+        if (offset + header->flag_width > header->termios_size) {
+            return false;
+        }
+    }
+    if (header->cc_offset + header->cc_count > header->termios_size) {
+        return false;
+    }
+    return size >= header->header_size + (uint64_t) header->capacity * header->record_size;
+}
+
+
+static SnapshotRecord *record_at(const SnapshotHeader *header, uint32_t index)
+{
+    return (SnapshotRecord *) ((char *) header + header->header_size + (size_t) index * header->record_size);
+}
+
+
+// find the valid record of a device, needs store_mutex
+static SnapshotRecord *find_record(uint64_t dev, uint64_t ino)
+{
+    for (uint32_t i = 0; i < store->count; ++i) {
+        SnapshotRecord *record = record_at(store, i);
+        if (record->state == SNAPSHOT_VALID && record->dev == dev && record->ino == ino) {
+            return record;
+        }
+    }
+    return nullptr;
+}
+
+
+// free slot for a new record, needs store_mutex
+static SnapshotRecord *free_record()
+{
+    for (uint32_t i = 0; i < store->count; ++i) {
+        SnapshotRecord *record = record_at(store, i);
+        if (record->state == SNAPSHOT_FREE) {
+            return record;
+        }
+    }
+    if (store->count == store->capacity) {
+        return nullptr;
+    }
+    return record_at(store, store->count);
+}
+
+
+/**
+ * Record the current state of fd. Known devices are only updated with overwrite.
+ * Returns 0 or an errno value.
+ */
+static int record_fd(int fd, bool overwrite)
+{
+    struct stat st;
+    if (fstat(fd, &st)) {
+        return errno;
+    }
+    std::lock_guard<std::mutex> lock(store_mutex);
+    if (!store) {
+        return EBADF;
+    }
+    SnapshotRecord *record = find_record(st.st_dev, st.st_ino);
+    if (record && !overwrite) {
+        return 0;
+    }
+
+    // gather everything before touching the record
+    char path[SNAPSHOT_PATH_SIZE];
+    int res = ttyname_r(fd, path, SNAPSHOT_PATH_SIZE);
+    if (res) {
+        return res;
+    }
+    struct termios attrs;
+    if (termios_tcgetattr(fd, &attrs)) {
+        return errno;
+    }
+    struct winsize ws;
+    if (ioctl(fd, TIOCGWINSZ, &ws)) {
+        memset(&ws, 0, sizeof(ws));
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    if (record) {
+        __atomic_store_n(&record->state, SNAPSHOT_FREE, __ATOMIC_RELEASE);
+    } else if (!(record = free_record())) {
+        return ENOSPC;
+    }
+    record->dev = st.st_dev;
+    record->ino = st.st_ino;
+    record->timestamp = (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    record->winsize[0] = ws.ws_row;
+    record->winsize[1] = ws.ws_col;
+    record->winsize[2] = ws.ws_xpixel;
+    record->winsize[3] = ws.ws_ypixel;
+    memset(record->path, 0, SNAPSHOT_PATH_SIZE);
+    strncpy(record->path, path, SNAPSHOT_PATH_SIZE - 1);
+    memcpy(record + 1, &attrs, sizeof(struct termios));
+    __atomic_store_n(&record->state, SNAPSHOT_VALID, __ATOMIC_RELEASE);
+    if (record == record_at(store, store->count)) {
+        __atomic_store_n(&store->count, store->count + 1, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+
+void snapshot_note(int fd)
+{
+    if (store_active.load(std::memory_order_relaxed)) {
+        int err = errno;
+        record_fd(fd, false);
+        errno = err;
+    }
+}
+
+
+static void close_store()
+{
+    store_active = false;
+    if (store) {
+        munmap(store, store_size);
+        store = nullptr;
+        store_size = 0;
+    }
+}
+
+
+// flag member of a foreign termios layout
+static tcflag_t load_flag(const char *data, uint32_t offset, uint32_t width)
+{
+    if (width == 8) {
+        uint64_t value;
+        memcpy(&value, data + offset, 8);
+        return (tcflag_t) value;
+    }
+    uint32_t value;
+    memcpy(&value, data + offset, 4);
+    return (tcflag_t) value;
+}
+
+
+/**
+ * Termios data of a record. A foreign layout gets converted on top
+ * of the current state of fd, thus fields beyond EXPLAIN (speeds) stay untouched.
+ */
+static int record_termios(const SnapshotHeader *header, bool same, const SnapshotRecord *record,
+                          int fd, struct termios *attrs)
+{
+    const char *data = (const char *) (record + 1);
+    if (same) {
+        memcpy(attrs, data, sizeof(struct termios));
+        return 0;
+    }
+    if (termios_tcgetattr(fd, attrs)) {
+        return errno;
+    }
+    attrs->c_iflag = load_flag(data, header->iflag_offset, header->flag_width);
+    attrs->c_oflag = load_flag(data, header->oflag_offset, header->flag_width);
+    attrs->c_cflag = load_flag(data, header->cflag_offset, header->flag_width);
+    attrs->c_lflag = load_flag(data, header->lflag_offset, header->flag_width);
+    memcpy(attrs->c_cc, data + header->cc_offset, header->cc_count < NCCS ? header->cc_count : NCCS);
+    return 0;
+}
+
+
+static int restore_record(const SnapshotHeader *header, bool same, const SnapshotRecord *record, int action)
+{
+    char path[SNAPSHOT_PATH_SIZE];
+    memcpy(path, record->path, SNAPSHOT_PATH_SIZE);
+    path[SNAPSHOT_PATH_SIZE - 1] = 0;
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1) {
+        return errno;
+    }
+    struct stat st;
+    struct termios attrs;
+    int res = 0;
+    if (fstat(fd, &st)) {
+        res = errno;
+    } else if ((uint64_t) st.st_dev != record->dev || (uint64_t) st.st_ino != record->ino) {
+        // path got reused by another device
+        res = ENODEV;
+    } else if (!(res = record_termios(header, same, record, fd, &attrs))) {
+        if (termios_tcsetattr(fd, action, &attrs)) {
+            res = errno;
+        } else if (record->winsize[0] || record->winsize[1]) {
+            struct winsize ws;
+            ws.ws_row = record->winsize[0];
+            ws.ws_col = record->winsize[1];
+            ws.ws_xpixel = record->winsize[2];
+            ws.ws_ypixel = record->winsize[3];
+            if (termios_setwinsize(fd, &ws)) {
+                res = errno;
+            }
+        }
+    }
+    close(fd);
+    return res;
+}
+
+
+NAN_METHOD(SnapshotOpen)
+{
+    if (info.Length() < 1 || info.Length() > 2 || !info[0]->IsString()
+          || (info.Length() == 2 && !info[1]->IsNumber())) {
+        return Nan::ThrowError("usage: termios.snapshot_open(path, capacity?)");
+    }
+    Nan::Utf8String path(info[0]);
+    int capacity = (info.Length() == 2) ? Nan::To<int>(info[1]).FromJust() : 64;
+    if (capacity < 1) {
+        return Nan::ThrowError("capacity must be positive");
+    }
+
+    std::lock_guard<std::mutex> lock(store_mutex);
+    close_store();
+    int fd = open(*path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        std::string error(strerror(errno));
+        return Nan::ThrowError((std::string("snapshot_open failed - ") + error).c_str());
+    }
+    struct stat st;
+    if (fstat(fd, &st)) {
+        std::string error(strerror(errno));
+        close(fd);
+        return Nan::ThrowError((std::string("snapshot_open failed - ") + error).c_str());
+    }
+    bool create = st.st_size == 0;
+    SnapshotHeader header;
+    if (create) {
+        init_header(&header, capacity);
+        size_t size = header.header_size + (size_t) header.capacity * header.record_size;
+        if (ftruncate(fd, size)) {
+            std::string error(strerror(errno));
+            close(fd);
+            return Nan::ThrowError((std::string("snapshot_open failed - ") + error).c_str());
+        }
+    } else if (pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)
+          || !valid_header(&header, st.st_size) || !same_layout(&header)) {
+        close(fd);
+        return Nan::ThrowError("snapshot_open failed - incompatible snapshot file");
+    }
+    store_size = header.header_size + (size_t) header.capacity * header.record_size;
+    void *mem = mmap(nullptr, store_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        std::string error(strerror(errno));
+        store_size = 0;
+        return Nan::ThrowError((std::string("snapshot_open failed - ") + error).c_str());
+    }
+    store = (SnapshotHeader *) mem;
+    if (create) {
+        memcpy(store, &header, sizeof(header));
+    }
+    store_active = true;
+    info.GetReturnValue().Set(Nan::New<Number>(store->capacity));
+}
+
+
+NAN_METHOD(SnapshotClose)
+{
+    std::lock_guard<std::mutex> lock(store_mutex);
+    close_store();
+    info.GetReturnValue().SetUndefined();
+}
+
+
+NAN_METHOD(SnapshotSave)
+{
+    if (info.Length() < 1 || info.Length() > 2 || !info[0]->IsNumber()
+          || (info.Length() == 2 && !info[1]->IsBoolean())) {
+        return Nan::ThrowError("usage: termios.snapshot_save(fd, overwrite?)");
+    }
+    bool overwrite = info.Length() == 2 && Nan::To<bool>(info[1]).FromJust();
+    info.GetReturnValue().Set(Nan::New<Number>(-record_fd(Nan::To<int>(info[0]).FromJust(), overwrite)));
+}
+
+
+NAN_METHOD(SnapshotForget)
+{
+    if (info.Length() != 1 || !info[0]->IsNumber()) {
+        return Nan::ThrowError("usage: termios.snapshot_forget(fd)");
+    }
+    struct stat st;
+    bool removed = false;
+    if (!fstat(Nan::To<int>(info[0]).FromJust(), &st)) {
+        std::lock_guard<std::mutex> lock(store_mutex);
+        SnapshotRecord *record = store ? find_record(st.st_dev, st.st_ino) : nullptr;
+        if (record) {
+            __atomic_store_n(&record->state, SNAPSHOT_FREE, __ATOMIC_RELEASE);
+            removed = true;
+        }
+    }
+    info.GetReturnValue().Set(Nan::New<Boolean>(removed));
+}
+
+
+NAN_METHOD(SnapshotRestoreAll)
+{
+    if (info.Length() < 1 || info.Length() > 2 || !info[0]->IsString()
+          || (info.Length() == 2 && !info[1]->IsNumber())) {
+        return Nan::ThrowError("usage: termios.snapshot_restore_all(path, action?)");
+    }
+    Nan::Utf8String path(info[0]);
+    int action = (info.Length() == 2) ? Nan::To<int>(info[1]).FromJust() : TCSANOW;
+
+    int fd = open(*path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        std::string error(strerror(errno));
+        return Nan::ThrowError((std::string("snapshot_restore_all failed - ") + error).c_str());
+    }
+    struct stat st;
+    void *mem = MAP_FAILED;
+    if (!fstat(fd, &st) && st.st_size >= (off_t) sizeof(SnapshotHeader)) {
+        mem = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mem == MAP_FAILED) {
+        return Nan::ThrowError("snapshot_restore_all failed - incompatible snapshot file");
+    }
+    const SnapshotHeader *header = (const SnapshotHeader *) mem;
+    if (!valid_header(header, st.st_size)) {
+        munmap(mem, st.st_size);
+        return Nan::ThrowError("snapshot_restore_all failed - incompatible snapshot file");
+    }
+    bool same = same_layout(header);
+
+    // single pass over all records, errors are reported per record
+    Local<Array> result = Nan::New<Array>();
+    uint32_t count = __atomic_load_n(&header->count, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0, j = 0; i < count; ++i) {
+        const SnapshotRecord *record = record_at(header, i);
+        if (__atomic_load_n(&record->state, __ATOMIC_ACQUIRE) != SNAPSHOT_VALID) {
+            continue;
+        }
+        int res = restore_record(header, same, record, action);
+        Local<Object> entry = Nan::New<Object>();
+        char name[SNAPSHOT_PATH_SIZE];
+        memcpy(name, record->path, SNAPSHOT_PATH_SIZE);
+        name[SNAPSHOT_PATH_SIZE - 1] = 0;
+        Nan::Set(entry, Nan::New<String>("path").ToLocalChecked(), Nan::New<String>(name).ToLocalChecked());
+        Nan::Set(entry, Nan::New<String>("dev").ToLocalChecked(), Nan::New<Number>((double) record->dev));
+        Nan::Set(entry, Nan::New<String>("ino").ToLocalChecked(), Nan::New<Number>((double) record->ino));
+        Nan::Set(entry, Nan::New<String>("timestamp").ToLocalChecked(), Nan::New<Number>((double) record->timestamp));
+        Nan::Set(entry, Nan::New<String>("error").ToLocalChecked(), Nan::New<Number>(-res));
+        Nan::Set(result, j++, entry);
+    }
+    munmap(mem, st.st_size);
+    info.GetReturnValue().Set(result);
+}
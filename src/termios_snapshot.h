@@ -0,0 +1,77 @@
+/* termios_snapshot.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TERMIOS_SNAPSHOT_H
+#define TERMIOS_SNAPSHOT_H
+
+#include "node_termios.h"
+#include <stdint.h>
+
+/**
+ * Memory mapped store of termios snapshots for restoring ttys after a crash.
+ *
+ * While a store is open, the first tcsetattr through this module on a device
+ * records the state the device had before (termios data and window size)
+ * together with device id, inode, path and a timestamp. Later changes of the
+ * same device do not touch the record, thus the store always holds the state
+ * to return to. The file is mapped shared, records written by a process
+ * survive its crash without any sync call.
+ *
+ * File layout (native byte order):
+ *   SnapshotHeader | record 0 | record 1 | ... | record capacity - 1
+ * Every record is a SnapshotRecord followed by the termios data padded to 8 bytes.
+ * The header carries the EXPLAIN layout of struct termios of the writing build,
+ * `snapshot_restore_all` converts flags and c_cc of a foreign layout.
+ */
+
+#define SNAPSHOT_MAGIC "TRMSNAP"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_PATH_SIZE 96
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t record_size;
+    uint32_t capacity;
+    uint32_t count;                 // slots in use (incl. forgotten ones)
+    // EXPLAIN layout of struct termios
+    uint32_t termios_size;
+    uint32_t flag_width;
+    uint32_t iflag_offset;
+    uint32_t oflag_offset;
+    uint32_t cflag_offset;
+    uint32_t lflag_offset;
+    uint32_t cc_offset;
+    uint32_t cc_count;
+    uint32_t reserved;
+};
+
+#define SNAPSHOT_FREE 0
+#define SNAPSHOT_VALID 1
+
+struct SnapshotRecord {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t timestamp;              // ms since epoch
+    uint32_t state;                 // SNAPSHOT_FREE or SNAPSHOT_VALID, written last
+    uint16_t winsize[4];            // rows, cols, xpixel, ypixel
+    uint32_t reserved;
+    char path[SNAPSHOT_PATH_SIZE];
+    // followed by termios data of header.termios_size bytes
+};
+
+// record the current state of fd, if a store is open and fd is not yet known
+void snapshot_note(int fd);
+
+NAN_METHOD(SnapshotOpen);
+NAN_METHOD(SnapshotClose);
+NAN_METHOD(SnapshotSave);
+NAN_METHOD(SnapshotForget);
+NAN_METHOD(SnapshotRestoreAll);
+
+#endif // TERMIOS_SNAPSHOT_H
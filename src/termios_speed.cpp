@@ -0,0 +1,263 @@
+/* termios_speed.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "termios_speed.h"
+#include "termios_stats.h"
+#include <errno.h>
+#include <string.h>
+
+#ifdef TERMIOS_ARBITRARY_BAUD
+#include "termios2_linux.h"
+#endif
+
+
+#define BAUD_ENTRY(rate) {B##rate, rate}
+
+/**
+ * B* constant <--> bit rate table.
+ * Same set of rates as exported in `BAUD`, without the EXTA/EXTB aliases.
+ */
+static const struct {
+    speed_t baud;
+    unsigned long rate;
+} baud_table[] = {
+    BAUD_ENTRY(0),
+    BAUD_ENTRY(50),
+    BAUD_ENTRY(75),
+    BAUD_ENTRY(110),
+    BAUD_ENTRY(134),
+    BAUD_ENTRY(150),
+    BAUD_ENTRY(200),
+    BAUD_ENTRY(300),
+    BAUD_ENTRY(600),
+    BAUD_ENTRY(1200),
+    BAUD_ENTRY(1800),
+    BAUD_ENTRY(2400),
+    BAUD_ENTRY(4800),
+    #ifdef B7200
+    BAUD_ENTRY(7200),
+    #endif
+    BAUD_ENTRY(9600),
+    #ifdef B14400
+    BAUD_ENTRY(14400),
+    #endif
+    BAUD_ENTRY(19200),
+    #ifdef B28800
+    BAUD_ENTRY(28800),
+    #endif
+    BAUD_ENTRY(38400),
+    BAUD_ENTRY(57600),
+    #ifdef B76800
+    BAUD_ENTRY(76800),
+    #endif
+    BAUD_ENTRY(115200),
+    BAUD_ENTRY(230400),
+    #ifdef B460800
+    BAUD_ENTRY(460800),
+    #endif
+    #ifdef B500000
+    BAUD_ENTRY(500000),
+    #endif
+    #ifdef B576000
+    BAUD_ENTRY(576000),
+    #endif
+    #ifdef B921600
+    BAUD_ENTRY(921600),
+    #endif
+    #ifdef B1000000
+    BAUD_ENTRY(1000000),
+    #endif
+    #ifdef B1152000
+    BAUD_ENTRY(1152000),
+    #endif
+    #ifdef B1500000
+    BAUD_ENTRY(1500000),
+    #endif
+    #ifdef B2000000
+    BAUD_ENTRY(2000000),
+    #endif
+    #ifdef B2500000
+    BAUD_ENTRY(2500000),
+    #endif
+    #ifdef B3000000
+    BAUD_ENTRY(3000000),
+    #endif
+    #ifdef B3500000
+    BAUD_ENTRY(3500000),
+    #endif
+    #ifdef B4000000
+    BAUD_ENTRY(4000000),
+    #endif
+};
+
+#define BAUD_TABLE_SIZE (sizeof(baud_table) / sizeof(baud_table[0]))
+
+
+long baud_to_rate(speed_t baud)
+{
+    for (size_t i = 0; i < BAUD_TABLE_SIZE; ++i) {
+        if (baud_table[i].baud == baud) {
+            return (long) baud_table[i].rate;
+        }
+    }
+    return -1;
+}
+
+
+long rate_to_baud(unsigned long rate)
+{
+    for (size_t i = 0; i < BAUD_TABLE_SIZE; ++i) {
+        if (baud_table[i].rate == rate) {
+            return (long) baud_table[i].baud;
+        }
+    }
+    return -1;
+}
+
+
+int termios_set_rate(struct termios *attrs, unsigned long rate)
+{
+    long baud = rate_to_baud(rate);
+    if (baud != -1) {
+        if (cfsetispeed(attrs, (speed_t) baud) || cfsetospeed(attrs, (speed_t) baud)) {
+            return -1;
+        }
+        return 0;
+    }
+    #ifdef TERMIOS_ARBITRARY_BAUD
+    // input speed follows output speed with CIBAUD cleared
+    attrs->c_cflag &= ~(CBAUD | CIBAUD);
+    attrs->c_cflag |= TERMIOS2_BOTHER;
+    attrs->c_ispeed = rate;
+    attrs->c_ospeed = rate;
+    return 0;
+    #else
+    errno = EINVAL;
+    return -1;
+    #endif
+}
+
+
+long termios_get_rate(const struct termios *attrs)
+{
+    #ifdef TERMIOS_ARBITRARY_BAUD
+    if ((attrs->c_cflag & CBAUD) == TERMIOS2_BOTHER) {
+        return (long) attrs->c_ospeed;
+    }
+    #endif
+    return baud_to_rate(cfgetospeed(attrs));
+}
+
+
+int termios_tcgetattr(int fd, struct termios *attrs)
+{
+    int res;
+    TERMIOS_CALL(STAT_TCGETATTR, res = tcgetattr(fd, attrs));
+    #ifdef TERMIOS_ARBITRARY_BAUD
+    if (!res && (attrs->c_cflag & CBAUD) == TERMIOS2_BOTHER) {
+        // libc does not know about the real rates
+        struct termios2_data data;
+        int res2;
+        TEMP_FAILURE_RETRY(res2 = termios2_get(fd, &data));
+        if (!res2) {
+            attrs->c_ispeed = data.ispeed;
+            attrs->c_ospeed = data.ospeed;
+        }
+    }
+    #endif
+    return res;
+}
+
+
+int termios_tcsetattr(int fd, int action, const struct termios *attrs)
+{
+    int res;
+    #ifdef TERMIOS_ARBITRARY_BAUD
+    if ((attrs->c_cflag & CBAUD) == TERMIOS2_BOTHER) {
+        int mode;
+        switch (action) {
+            case TCSANOW: mode = TERMIOS2_NOW; break;
+            case TCSADRAIN: mode = TERMIOS2_DRAIN; break;
+            case TCSAFLUSH: mode = TERMIOS2_FLUSH; break;
+            default:
+                errno = EINVAL;
+                return -1;
+        }
+        struct termios2_data data;
+        data.iflag = attrs->c_iflag;
+        data.oflag = attrs->c_oflag;
+        data.cflag = attrs->c_cflag;
+        data.lflag = attrs->c_lflag;
+        data.line = attrs->c_line;
+        memset(data.cc, 0, sizeof(data.cc));
+        memcpy(data.cc, attrs->c_cc, (NCCS < sizeof(data.cc)) ? NCCS : sizeof(data.cc));
+        data.ispeed = attrs->c_ispeed;
+        data.ospeed = attrs->c_ospeed;
+        TERMIOS_CALL(STAT_TCSETATTR, res = termios2_set(fd, mode, &data));
+        return res;
+    }
+    #endif
+    TERMIOS_CALL(STAT_TCSETATTR, res = tcsetattr(fd, action, attrs));
+    return res;
+}
+
+
+NAN_METHOD(Cfgetrate)
+{
+    if (info.Length() != 1
+          || !info[0]->IsObject()) {
+        return Nan::ThrowError("usage: termios.cfgetrate(buffer)");
+    }
+    if (!Buffer::HasInstance(info[0]) || Buffer::Length(info[0]) != sizeof(struct termios)) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    struct termios *buf = (struct termios *) Buffer::Data(info[0]);
+    info.GetReturnValue().Set(Nan::New<Number>(termios_get_rate(buf)));
+}
+
+
+NAN_METHOD(Cfsetrate)
+{
+    if (info.Length() != 2
+          || !info[0]->IsObject()
+          || !info[1]->IsNumber()) {
+        return Nan::ThrowError("usage: termios.cfsetrate(buffer, rate)");
+    }
+    if (!Buffer::HasInstance(info[0]) || Buffer::Length(info[0]) != sizeof(struct termios)) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    double rate = Nan::To<double>(info[1]).FromJust();
+    if (rate < 0 || rate > 0xFFFFFFFF || rate != (unsigned long) rate) {
+        return Nan::ThrowError("cfsetrate failed - invalid rate");
+    }
+    struct termios *buf = (struct termios *) Buffer::Data(info[0]);
+    if (termios_set_rate(buf, (unsigned long) rate)) {
+        std::string error(strerror(errno));
+        return Nan::ThrowError((std::string("cfsetrate failed - ") + error).c_str());
+    }
+    info.GetReturnValue().SetUndefined();
+}
+
+
+NAN_METHOD(BaudToRate)
+{
+    if (info.Length() != 1 || !info[0]->IsNumber()) {
+        return Nan::ThrowError("usage: termios.baud_to_rate(baud)");
+    }
+    info.GetReturnValue().Set(Nan::New<Number>(
+        baud_to_rate((speed_t) Nan::To<uint32_t>(info[0]).FromJust())));
+}
+
+
+NAN_METHOD(RateToBaud)
+{
+    if (info.Length() != 1 || !info[0]->IsNumber()) {
+        return Nan::ThrowError("usage: termios.rate_to_baud(rate)");
+    }
+    info.GetReturnValue().Set(Nan::New<Number>(
+        rate_to_baud(Nan::To<uint32_t>(info[0]).FromJust())));
+}
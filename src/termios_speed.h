@@ -0,0 +1,43 @@
+/* termios_speed.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TERMIOS_SPEED_H
+#define TERMIOS_SPEED_H
+
+#include "node_termios.h"
+
+// arbitrary baud rates via termios2/BOTHER (Linux glibc only)
+#if defined(__linux__) && defined(CBAUD) \
+    && defined(_HAVE_STRUCT_TERMIOS_C_ISPEED) && defined(_HAVE_STRUCT_TERMIOS_C_OSPEED)
+#define TERMIOS_ARBITRARY_BAUD 1
+#endif
+
+// conversion between B* constants and bit rates, both return -1 if unknown
+long baud_to_rate(speed_t baud);
+long rate_to_baud(unsigned long rate);
+
+// set both speeds of `attrs` to bit rate `rate`, returns 0 or -1 with errno set
+int termios_set_rate(struct termios *attrs, unsigned long rate);
+// get output bit rate of `attrs` (-1 if unknown)
+long termios_get_rate(const struct termios *attrs);
+
+/**
+ * tcgetattr / tcsetattr aware of BOTHER.
+ *
+ * Data holding a non table rate is transferred with termios2 ioctls,
+ * the bit rates are kept in `c_ispeed` and `c_ospeed`.
+ * Elsewhere these are plain tcgetattr / tcsetattr calls.
+ */
+int termios_tcgetattr(int fd, struct termios *attrs);
+int termios_tcsetattr(int fd, int action, const struct termios *attrs);
+
+NAN_METHOD(Cfgetrate);
+NAN_METHOD(Cfsetrate);
+NAN_METHOD(BaudToRate);
+NAN_METHOD(RateToBaud);
+
+#endif // TERMIOS_SPEED_H
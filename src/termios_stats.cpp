@@ -0,0 +1,194 @@
+/* termios_stats.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "termios_stats.h"
+#include "termios_raw.h"
+#include <time.h>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+std::atomic<bool> termios_stats_enabled(false);
+
+static const char *op_names[STAT_OPS] = {
+    "tcgetattr", "tcsetattr", "tcsendbreak", "tcdrain", "tcflush", "tcflow", "writev"
+};
+
+
+struct OpCounters {
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> errors;
+    std::atomic<uint64_t> eintr;
+    std::atomic<uint64_t> nanos;
+    std::atomic<uint64_t> errnos[STAT_ERRNO_SLOTS];
+    std::atomic<uint64_t> buckets[STAT_BUCKETS];
+};
+
+
+/**
+ * Counters of a single thread. Blocks of exited threads are
+ * kept in the registry, thus counts never get lost.
+ */
+struct ThreadStats {
+    OpCounters ops[STAT_OPS];
+
+    ThreadStats()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        for (int i = 0; i < STAT_OPS; ++i) {
+            OpCounters &op = ops[i];
+            op.calls = 0;
+            op.errors = 0;
+            op.eintr = 0;
+            op.nanos = 0;
+            for (int j = 0; j < STAT_ERRNO_SLOTS; ++j) {
+                op.errnos[j] = 0;
+            }
+            for (int j = 0; j < STAT_BUCKETS; ++j) {
+                op.buckets[j] = 0;
+            }
+        }
+    }
+};
+
+static std::mutex registry_mutex;
+static std::vector<ThreadStats *> registry;
+
+
+static ThreadStats *thread_stats()
+{
+    static thread_local ThreadStats *stats = NULL;
+    if (!stats) {
+        stats = new ThreadStats();
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.push_back(stats);
+    }
+    return stats;
+}
+
+
+uint64_t stats_clock()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static inline void bump(std::atomic<uint64_t> &counter, uint64_t value = 1)
+{
+    // single writer - no read-modify-write needed
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+
+void stats_record(int op, int res, uint32_t retries, uint64_t start)
+{
+    int err = errno;
+    uint64_t elapsed = stats_clock() - start;
+    OpCounters &counters = thread_stats()->ops[op];
+    bump(counters.calls);
+    bump(counters.nanos, elapsed);
+    if (retries) {
+        bump(counters.eintr, retries);
+    }
+    if (res == -1) {
+        bump(counters.errors);
+        bump(counters.errnos[(err > 0 && err < STAT_ERRNO_SLOTS) ? err : STAT_ERRNO_SLOTS - 1]);
+    }
+    int bucket = elapsed ? 63 - __builtin_clzll(elapsed) : 0;
+    bump(counters.buckets[std::min(bucket, STAT_BUCKETS - 1)]);
+    errno = err;
+}
+
+
+NAN_METHOD(StatsEnable)
+{
+    if (info.Length() != 1 || !info[0]->IsBoolean()) {
+        return Nan::ThrowError("usage: termios.stats_enable(enable)");
+    }
+    termios_stats_enabled = Nan::To<bool>(info[0]).FromJust();
+    info.GetReturnValue().SetUndefined();
+}
+
+
+/**
+ * Summed counters of all threads:
+ * {enabled, ops: {tcgetattr: {calls, errors, eintr, totalNs, errno: {EIO: 2}, histogram: [...]}, ...}}
+ * with errno values by name (number for values not in ERRNO).
+ * The histogram holds the call count per log2 bucket of the latency in ns
+ * (index i: [2^i, 2^(i+1)) ns), trailing empty buckets are cut off.
+ */
+NAN_METHOD(Stats)
+{
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result, Nan::New<String>("enabled").ToLocalChecked(), Nan::New<Boolean>(termios_stats_enabled.load()));
+    Local<Object> ops = Nan::New<Object>();
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (int i = 0; i < STAT_OPS; ++i) {
+        uint64_t calls = 0, errors = 0, eintr = 0, nanos = 0;
+        uint64_t errnos[STAT_ERRNO_SLOTS] = {0};
+        uint64_t buckets[STAT_BUCKETS] = {0};
+        for (size_t t = 0; t < registry.size(); ++t) {
+            OpCounters &op = registry[t]->ops[i];
+            calls += op.calls.load(std::memory_order_relaxed);
+            errors += op.errors.load(std::memory_order_relaxed);
+            eintr += op.eintr.load(std::memory_order_relaxed);
+            nanos += op.nanos.load(std::memory_order_relaxed);
+            for (int j = 0; j < STAT_ERRNO_SLOTS; ++j) {
+                errnos[j] += op.errnos[j].load(std::memory_order_relaxed);
+            }
+            for (int j = 0; j < STAT_BUCKETS; ++j) {
+                buckets[j] += op.buckets[j].load(std::memory_order_relaxed);
+            }
+        }
+        Local<Object> entry = Nan::New<Object>();
+        Nan::Set(entry, Nan::New<String>("calls").ToLocalChecked(), Nan::New<Number>((double) calls));
+        Nan::Set(entry, Nan::New<String>("errors").ToLocalChecked(), Nan::New<Number>((double) errors));
+        Nan::Set(entry, Nan::New<String>("eintr").ToLocalChecked(), Nan::New<Number>((double) eintr));
+        Nan::Set(entry, Nan::New<String>("totalNs").ToLocalChecked(), Nan::New<Number>((double) nanos));
+        Local<Object> by_errno = Nan::New<Object>();
+        for (int j = 1; j < STAT_ERRNO_SLOTS; ++j) {
+            if (errnos[j]) {
+                const char *name = termios_errname(j);
+                std::string key = name ? name : std::to_string(j);
+                Nan::Set(by_errno, Nan::New<String>(key).ToLocalChecked(), Nan::New<Number>((double) errnos[j]));
+            }
+        }
+        Nan::Set(entry, Nan::New<String>("errno").ToLocalChecked(), by_errno);
+        int used = STAT_BUCKETS;
+        while (used && !buckets[used - 1]) {
+            --used;
+        }
+        Local<Array> histogram = Nan::New<Array>(used);
+        for (int j = 0; j < used; ++j) {
+            Nan::Set(histogram, j, Nan::New<Number>((double) buckets[j]));
+        }
+        Nan::Set(entry, Nan::New<String>("histogram").ToLocalChecked(), histogram);
+        Nan::Set(ops, Nan::New<String>(op_names[i]).ToLocalChecked(), entry);
+    }
+    Nan::Set(result, Nan::New<String>("ops").ToLocalChecked(), ops);
+    info.GetReturnValue().Set(result);
+}
+
+
+/**
+ * Zero all counters. Counts of calls running meanwhile on
+ * other threads might survive the reset.
+ */
+NAN_METHOD(ResetStats)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (size_t t = 0; t < registry.size(); ++t) {
+        registry[t]->reset();
+    }
+    info.GetReturnValue().SetUndefined();
+}
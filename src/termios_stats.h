@@ -0,0 +1,75 @@
+/* termios_stats.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TERMIOS_STATS_H
+#define TERMIOS_STATS_H
+
+#include "node_termios.h"
+#include <errno.h>
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * Opt-in syscall instrumentation.
+ *
+ * Every thread counts into its own block of relaxed atomics (only written
+ * by the owning thread), `stats()` sums up the blocks of all threads.
+ * Disabled, a call costs a single relaxed load.
+ */
+
+// instrumented operations
+#define STAT_TCGETATTR 0
+#define STAT_TCSETATTR 1
+#define STAT_TCSENDBREAK 2
+#define STAT_TCDRAIN 3
+#define STAT_TCFLUSH 4
+#define STAT_TCFLOW 5
+#define STAT_WRITEV 6
+#define STAT_OPS 7
+
+// errno values counted separately, higher values share the last slot
+#define STAT_ERRNO_SLOTS 160
+
+// log2 latency buckets in nanoseconds, bucket i holds [2^i, 2^(i+1))
+#define STAT_BUCKETS 40
+
+extern std::atomic<bool> termios_stats_enabled;
+
+uint64_t stats_clock();
+
+// record a finished call, preserves errno
+void stats_record(int op, int res, uint32_t retries, uint64_t start);
+
+/**
+ * TEMP_FAILURE_RETRY with instrumentation, e.g.
+ *     TERMIOS_CALL(STAT_TCDRAIN, res = tcdrain(fd));
+ * Counts the call, errors by errno, EINTR retries and the latency
+ * (including retries) of `op`, if stats are enabled.
+ */
+#define TERMIOS_CALL(op, exp)                                          \
+  ({                                                                   \
+    int _rc;                                                           \
+    if (!termios_stats_enabled.load(std::memory_order_relaxed)) {      \
+      do {                                                             \
+        _rc = (exp);                                                   \
+      } while (_rc == -1 && errno == EINTR);                           \
+    } else {                                                           \
+      uint64_t _start = stats_clock();                                 \
+      uint32_t _retries = 0;                                           \
+      while ((_rc = (exp)) == -1 && errno == EINTR) {                  \
+        _retries++;                                                    \
+      }                                                                \
+      stats_record(op, _rc, _retries, _start);                         \
+    }                                                                  \
+    _rc;                                                               \
+  })
+
+NAN_METHOD(StatsEnable);
+NAN_METHOD(Stats);
+NAN_METHOD(ResetStats);
+
+#endif // TERMIOS_STATS_H
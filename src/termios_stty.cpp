@@ -0,0 +1,622 @@
+/* termios_stty.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "termios_stty.h"
+#include "termios_symbols.h"
+#include "termios_speed.h"
+#include "termios_cache.h"
+#include <errno.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#ifndef _POSIX_VDISABLE
+#define _POSIX_VDISABLE 0
+#endif
+
+
+// flag words in patch order, named by their symbol group
+static const char *flag_groups[4] = {"IFLAGS", "OFLAGS", "CFLAGS", "LFLAGS"};
+#define IFLAG_WORD 0
+#define OFLAG_WORD 1
+#define CFLAG_WORD 2
+#define LFLAG_WORD 3
+
+
+// control characters by stty name
+struct CcName {
+    const char *name;
+    int index;
+};
+
+static const CcName cc_names[] = {
+    {"intr", VINTR},
+    {"quit", VQUIT},
+    {"erase", VERASE},
+    {"kill", VKILL},
+    {"eof", VEOF},
+    {"eol", VEOL},
+    {"eol2", VEOL2},
+    #ifdef VSWTCH
+    {"swtch", VSWTCH},
+    #endif
+    {"start", VSTART},
+    {"stop", VSTOP},
+    {"susp", VSUSP},
+    #ifdef VDSUSP
+    {"dsusp", VDSUSP},
+    #endif
+    {"rprnt", VREPRINT},
+    {"werase", VWERASE},
+    {"lnext", VLNEXT},
+    {"discard", VDISCARD},
+    #ifdef VSTATUS
+    {"status", VSTATUS},
+    #endif
+    {"min", VMIN},
+    {"time", VTIME},
+    {NULL, 0}
+};
+
+
+/**
+ * Multi bit fields - settings like `cs8` replace the whole field and
+ * cannot be negated. The field values are recognized by their name
+ * (prefix followed by a digit), since values like CS8 or TAB3 might
+ * equal the field mask.
+ */
+struct Field {
+    int word;
+    uint32_t mask;
+    const char *prefix;
+};
+
+static const Field fields[] = {
+    {CFLAG_WORD, CSIZE, "CS"},
+    #ifdef TABDLY
+    {OFLAG_WORD, TABDLY, "TAB"},
+    #endif
+    #ifdef NLDLY
+    {OFLAG_WORD, NLDLY, "NL"},
+    #endif
+    #ifdef CRDLY
+    {OFLAG_WORD, CRDLY, "CR"},
+    #endif
+    #ifdef BSDLY
+    {OFLAG_WORD, BSDLY, "BS"},
+    #endif
+    #ifdef VTDLY
+    {OFLAG_WORD, VTDLY, "VT"},
+    #endif
+    #ifdef FFDLY
+    {OFLAG_WORD, FFDLY, "FF"},
+    #endif
+    {0, 0, NULL}
+};
+
+// mask symbols, no valid settings on their own
+static const char *mask_names[] = {
+    "CSIZE", "CBAUD", "CBAUDEX", "CIBAUD", "TABDLY", "NLDLY",
+    "CRDLY", "BSDLY", "VTDLY", "FFDLY", NULL
+};
+
+
+static const Field *field_of(int word, const char *name)
+{
+    for (const Field *field = fields; field->prefix; ++field) {
+        size_t length = strlen(field->prefix);
+        if (field->word == word && !strncmp(name, field->prefix, length)
+                && isdigit((unsigned char) name[length]) && !name[length + 1]) {
+            return field;
+        }
+    }
+    return NULL;
+}
+
+
+static bool is_mask(const char *name)
+{
+    for (const char **mask = mask_names; *mask; ++mask) {
+        if (!strcmp(name, *mask)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static void set_bits(TermiosPatch *patch, int word, uint32_t mask, uint32_t value)
+{
+    patch->clear[word] |= mask;
+    patch->set[word] = (patch->set[word] & ~mask) | value;
+}
+
+
+static void clear_bits(TermiosPatch *patch, int word, uint32_t mask)
+{
+    patch->clear[word] |= mask;
+    patch->set[word] &= ~mask;
+}
+
+
+static void set_cc(TermiosPatch *patch, int index, cc_t value)
+{
+    patch->cc_mask[index] = 1;
+    patch->cc[index] = value;
+}
+
+
+// settings made of several others
+struct Combination {
+    const char *name;
+    const char *spec;
+};
+
+static const Combination combinations[] = {
+    // same as Termios.setraw / setcbreak
+    {"raw", "-brkint -icrnl -inpck -istrip -ixon -opost -parenb cs8 -echo -icanon -iexten -isig min 1 time 0"},
+    {"cbreak", "-echo -icanon min 1 time 0"},
+    {"-cbreak", "echo icanon"},
+    {"evenp", "parenb -parodd cs7"},
+    {"parity", "parenb -parodd cs7"},
+    {"oddp", "parenb parodd cs7"},
+    {"-evenp", "-parenb cs8"},
+    {"-parity", "-parenb cs8"},
+    {"-oddp", "-parenb cs8"},
+    {"nl", "-icrnl -onlcr"},
+    {"-nl", "icrnl -inlcr -igncr onlcr -ocrnl -onlret"},
+    {NULL, NULL}
+};
+
+
+/**
+ * Cooked mode as in Termios.setcooked - the flag words get replaced
+ * instead of single bits being changed.
+ */
+static void compile_cooked(TermiosPatch *patch)
+{
+    set_bits(patch, IFLAG_WORD, 0xFFFFFFFF, BRKINT | ICRNL | INPCK | ISTRIP | IXON | IGNPAR);
+    set_bits(patch, OFLAG_WORD, 0xFFFFFFFF, OPOST | ONLCR);
+    set_bits(patch, CFLAG_WORD, CSIZE, CS8);
+    uint32_t lflag = ECHOKE | ECHOCTL | ECHOE | ECHO | ICANON | IEXTEN | ISIG;
+    #ifdef ECHOK
+    lflag |= ECHOK;
+    #endif
+    set_bits(patch, LFLAG_WORD, 0xFFFFFFFF, lflag);
+}
+
+
+/**
+ * Parse a control character value: `^X`, `^?`, `^-` / `undef` (disabled),
+ * a number (decimal, 0x hex or 0 octal) or a single character.
+ */
+static bool parse_cc(const std::string &value, bool numeric, cc_t *out)
+{
+    if (!numeric) {
+        if (value == "^-" || value == "undef") {
+            *out = _POSIX_VDISABLE;
+            return true;
+        }
+        if (value.size() == 2 && value[0] == '^') {
+            *out = (value[1] == '?') ? 127 : (toupper((unsigned char) value[1]) & 0x1F);
+            return true;
+        }
+        if (value.size() == 1 && !isdigit((unsigned char) value[0])) {
+            *out = (unsigned char) value[0];
+            return true;
+        }
+    }
+    char *end;
+    long number = strtol(value.c_str(), &end, numeric ? 10 : 0);
+    if (value.empty() || *end || number < 0 || number > 255) {
+        return false;
+    }
+    *out = (cc_t) number;
+    return true;
+}
+
+
+static bool compile_token(const std::string &token, TermiosPatch *patch, std::string *error);
+
+static bool compile_tokens(const char *spec, TermiosPatch *patch, std::string *error)
+{
+    std::vector<std::string> tokens;
+    const char *p = spec;
+    while (*p) {
+        while (isspace((unsigned char) *p)) {
+            ++p;
+        }
+        const char *start = p;
+        while (*p && !isspace((unsigned char) *p)) {
+            ++p;
+        }
+        if (p != start) {
+            tokens.push_back(std::string(start, p - start));
+        }
+    }
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        const std::string &token = tokens[i];
+
+        // control characters take a value
+        const CcName *cc = NULL;
+        for (const CcName *entry = cc_names; entry->name; ++entry) {
+            if (token == entry->name) {
+                cc = entry;
+                break;
+            }
+        }
+        if (cc) {
+            if (++i >= tokens.size()) {
+                *error = "missing value for '" + token + "'";
+                return false;
+            }
+            cc_t value;
+            bool numeric = token == "min" || token == "time";
+            if (!parse_cc(tokens[i], numeric, &value)) {
+                *error = "invalid value '" + tokens[i] + "' for '" + token + "'";
+                return false;
+            }
+            set_cc(patch, cc->index, value);
+            continue;
+        }
+
+        // speed - a plain number
+        if (isdigit((unsigned char) token[0])) {
+            char *end;
+            unsigned long rate = strtoul(token.c_str(), &end, 10);
+            #ifdef TERMIOS_ARBITRARY_BAUD
+            bool valid = !*end && rate > 0;
+            #else
+            bool valid = !*end && rate > 0 && rate_to_baud(rate) != -1;
+            #endif
+            if (!valid || rate > 0xFFFFFFFF) {
+                *error = "unsupported speed '" + token + "'";
+                return false;
+            }
+            patch->rate = (uint32_t) rate;
+            continue;
+        }
+
+        if (!compile_token(token, patch, error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static bool compile_token(const std::string &token, TermiosPatch *patch, std::string *error)
+{
+    if (token == "cooked" || token == "-raw") {
+        compile_cooked(patch);
+        return true;
+    }
+    for (const Combination *combination = combinations; combination->name; ++combination) {
+        if (token == combination->name) {
+            return compile_tokens(combination->spec, patch, error);
+        }
+    }
+
+    // single flags, `-` prefix clears the flag
+    bool negate = token[0] == '-';
+    std::string name = token.substr(negate ? 1 : 0);
+    for (size_t i = 0; i < name.size(); ++i) {
+        name[i] = toupper((unsigned char) name[i]);
+    }
+    for (int word = 0; word < 4; ++word) {
+        const SymbolEntry *entry = termios_symbol(flag_groups[word], name.c_str());
+        if (!entry || is_mask(entry->name)) {
+            continue;
+        }
+        const Field *field = field_of(word, entry->name);
+        if (field) {
+            // multi bit values cannot be negated
+            if (negate) {
+                break;
+            }
+            set_bits(patch, word, field->mask, entry->value);
+        } else if (!entry->value) {
+            break;
+        } else if (negate) {
+            clear_bits(patch, word, entry->value);
+        } else {
+            set_bits(patch, word, entry->value, entry->value);
+        }
+        return true;
+    }
+    *error = "unknown setting '" + token + "'";
+    return false;
+}
+
+
+bool stty_compile(const char *spec, TermiosPatch *patch, std::string *error)
+{
+    memset(patch, 0, sizeof(TermiosPatch));
+    patch->magic = TERMIOS_PATCH_MAGIC;
+    return compile_tokens(spec, patch, error);
+}
+
+
+int stty_apply(const TermiosPatch *patch, struct termios *attrs)
+{
+    if (patch->rate && termios_set_rate(attrs, patch->rate)) {
+        return -1;
+    }
+    attrs->c_iflag = (attrs->c_iflag & ~patch->clear[IFLAG_WORD]) | patch->set[IFLAG_WORD];
+    attrs->c_oflag = (attrs->c_oflag & ~patch->clear[OFLAG_WORD]) | patch->set[OFLAG_WORD];
+    attrs->c_cflag = (attrs->c_cflag & ~patch->clear[CFLAG_WORD]) | patch->set[CFLAG_WORD];
+    attrs->c_lflag = (attrs->c_lflag & ~patch->clear[LFLAG_WORD]) | patch->set[LFLAG_WORD];
+    for (int i = 0; i < NCCS; ++i) {
+        if (patch->cc_mask[i]) {
+            attrs->c_cc[i] = patch->cc[i];
+        }
+    }
+    return 0;
+}
+
+
+static const TermiosPatch *patch_arg(Local<Value> value)
+{
+    if (!Buffer::HasInstance(value) || Buffer::Length(value) != sizeof(TermiosPatch)) {
+        return NULL;
+    }
+    const TermiosPatch *patch = (const TermiosPatch *) Buffer::Data(value);
+    return (patch->magic == TERMIOS_PATCH_MAGIC) ? patch : NULL;
+}
+
+
+NAN_METHOD(SttyCompile)
+{
+    if (info.Length() != 1 || !info[0]->IsString()) {
+        return Nan::ThrowError("usage: termios.stty_compile(spec)");
+    }
+    Nan::Utf8String spec(info[0]);
+    TermiosPatch patch;
+    std::string error;
+    if (!stty_compile(*spec, &patch, &error)) {
+        return Nan::ThrowError((std::string("stty_compile failed - ") + error).c_str());
+    }
+    info.GetReturnValue().Set(Nan::CopyBuffer((const char *) &patch, sizeof(TermiosPatch)).ToLocalChecked());
+}
+
+
+NAN_METHOD(SttyApply)
+{
+    if (info.Length() != 2) {
+        return Nan::ThrowError("usage: termios.stty_apply(patch, buffer)");
+    }
+    const TermiosPatch *patch = patch_arg(info[0]);
+    struct termios *buf = termios_arg(info[1]);
+    if (!patch || !buf) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    if (stty_apply(patch, buf)) {
+        std::string error(strerror(errno));
+        return Nan::ThrowError((std::string("stty_apply failed - ") + error).c_str());
+    }
+}
+
+
+static std::string describe_cc(const CcName *entry, cc_t value)
+{
+    // VMIN / VTIME might share their slot with VEOF / VEOL
+    if (!strcmp(entry->name, "min") || !strcmp(entry->name, "time")) {
+        return std::to_string(value);
+    }
+    if (value == _POSIX_VDISABLE) {
+        return "<undef>";
+    }
+    if (value == 127) {
+        return "^?";
+    }
+    if (value < 32) {
+        return std::string("^") + (char) (value + 64);
+    }
+    return std::string(1, (char) value);
+}
+
+
+static std::string lower(const char *name)
+{
+    std::string result(name);
+    for (size_t i = 0; i < result.size(); ++i) {
+        result[i] = tolower((unsigned char) result[i]);
+    }
+    return result;
+}
+
+
+/**
+ * Describe termios data - structured as
+ * {speed, iflag: [...], oflag: [...], cflag: [...], lflag: [...], cc: {...}}
+ * with flags in stty notation (`echo`, `-icanon`, `cs8`),
+ * or as text similar to `stty -a`.
+ */
+NAN_METHOD(SttyDescribe)
+{
+    if (info.Length() < 1 || info.Length() > 2) {
+        return Nan::ThrowError("usage: termios.stty_describe(buffer, text?)");
+    }
+    const struct termios *attrs = termios_arg(info[0]);
+    if (!attrs) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    bool text = info.Length() == 2 && Nan::To<bool>(info[1]).FromJust();
+    const tcflag_t words[4] = {attrs->c_iflag, attrs->c_oflag, attrs->c_cflag, attrs->c_lflag};
+    static const char *word_names[4] = {"iflag", "oflag", "cflag", "lflag"};
+    long rate = termios_get_rate(attrs);
+
+    std::string out = "speed " + std::to_string(rate) + " baud;\n";
+    Local<Object> result = Nan::New<Object>();
+    Local<Object> cc = Nan::New<Object>();
+    for (const CcName *entry = cc_names; entry->name; ++entry) {
+        std::string value = describe_cc(entry, attrs->c_cc[entry->index]);
+        if (text) {
+            out += std::string(entry->name) + " = " + value + "; ";
+        } else {
+            Nan::Set(cc, Nan::New<String>(entry->name).ToLocalChecked(), Nan::New<String>(value).ToLocalChecked());
+        }
+    }
+    for (int word = 0; word < 4; ++word) {
+        Local<Array> flags = Nan::New<Array>();
+        uint32_t count = 0;
+        out += "\n";
+        const SymbolEntry *entry = NULL;
+        for (const SymbolGroup *group = symbol_groups; group->name; ++group) {
+            if (!strcmp(group->name, flag_groups[word])) {
+                entry = group->entries;
+            }
+        }
+        for (; entry && entry->name; ++entry) {
+            if (is_mask(entry->name)) {
+                continue;
+            }
+            std::string name;
+            const Field *field = field_of(word, entry->name);
+            if (field) {
+                // only the matching value of a multi bit field
+                if ((words[word] & field->mask) != entry->value) {
+                    continue;
+                }
+                name = lower(entry->name);
+            } else if (entry->value) {
+                name = ((words[word] & entry->value) ? "" : "-") + lower(entry->name);
+            } else {
+                continue;
+            }
+            if (text) {
+                out += name + " ";
+            } else {
+                Nan::Set(flags, count++, Nan::New<String>(name).ToLocalChecked());
+            }
+        }
+        if (!text) {
+            Nan::Set(result, Nan::New<String>(word_names[word]).ToLocalChecked(), flags);
+        }
+    }
+    if (text) {
+        info.GetReturnValue().Set(Nan::New<String>(out).ToLocalChecked());
+        return;
+    }
+    Nan::Set(result, Nan::New<String>("speed").ToLocalChecked(), Nan::New<Number>(rate));
+    Nan::Set(result, Nan::New<String>("cc").ToLocalChecked(), cc);
+    info.GetReturnValue().Set(result);
+}
+
+
+/**
+ * Mode presets - compiled once from the same specs as Termios.setraw,
+ * setcbreak and setcooked.
+ */
+static const TermiosPatch *preset_patch(int preset)
+{
+    struct Presets {
+        TermiosPatch patches[3];
+        Presets()
+        {
+            static const char *specs[3] = {"raw", "cbreak", "cooked"};
+            std::string error;
+            for (int i = 0; i < 3; ++i) {
+                stty_compile(specs[i], patches + i, &error);
+            }
+        }
+    };
+    static const Presets presets;
+    return (preset >= MODE_RAW && preset <= MODE_COOKED) ? presets.patches + preset : NULL;
+}
+
+
+bool mode_apply(int preset, struct termios *attrs)
+{
+    if (preset == MODE_CFMAKERAW) {
+        #ifdef TERMIOS_HAS_CFMAKERAW
+        cfmakeraw(attrs);
+        return true;
+        #else
+        return false;
+        #endif
+    }
+    const TermiosPatch *patch = preset_patch(preset);
+    return patch && !stty_apply(patch, attrs);
+}
+
+
+/**
+ * Apply a mode preset to termios data (no syscalls).
+ */
+NAN_METHOD(ApplyMode)
+{
+    if (info.Length() != 2 || !info[1]->IsInt32()) {
+        return Nan::ThrowError("usage: termios.apply_mode(buffer, preset)");
+    }
+    struct termios *buf = termios_arg(info[0]);
+    if (!buf) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    if (!mode_apply(int32_arg(info[1]), buf)) {
+        return Nan::ThrowError("apply_mode failed - unsupported preset");
+    }
+}
+
+
+/**
+ * Switch the mode of `fd` with a single call:
+ * tcgetattr, apply preset (or copy `snapshot` for MODE.SNAPSHOT) and tcsetattr.
+ * The previous state is written to `prev` if given.
+ */
+NAN_METHOD(SetMode)
+{
+    if (info.Length() < 3 || info.Length() > 5 || !info[0]->IsInt32()
+            || !info[1]->IsInt32() || !info[2]->IsInt32()) {
+        return Nan::ThrowError("usage: termios.setmode(fd, preset, action, prev?, snapshot?)");
+    }
+    int fd = int32_arg(info[0]);
+    int preset = int32_arg(info[1]);
+    struct termios *prev = NULL;
+    struct termios *snapshot = NULL;
+    if (info.Length() > 3 && !info[3]->IsNull() && !info[3]->IsUndefined() && !(prev = termios_arg(info[3]))) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    if (preset == MODE_SNAPSHOT && (info.Length() < 5 || !(snapshot = termios_arg(info[4])))) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    struct termios attrs;
+    if (termios_tcgetattr(fd, &attrs)) {
+        std::string error(strerror(errno));
+        return Nan::ThrowError((std::string("setmode failed - ") + error).c_str());
+    }
+    if (prev) {
+        *prev = attrs;
+    }
+    if (snapshot) {
+        attrs = *snapshot;
+    } else if (!mode_apply(preset, &attrs)) {
+        return Nan::ThrowError("setmode failed - unsupported preset");
+    }
+    if (cached_tcsetattr(fd, int32_arg(info[2]), &attrs)) {
+        std::string error(strerror(errno));
+        return Nan::ThrowError((std::string("setmode failed - ") + error).c_str());
+    }
+}
+
+
+NAN_MODULE_INIT(InitMode)
+{
+    Local<Object> modes = Nan::New<Object>();
+    Nan::Set(modes, Nan::New<String>("RAW").ToLocalChecked(), Nan::New<Number>(MODE_RAW));
+    Nan::Set(modes, Nan::New<String>("CBREAK").ToLocalChecked(), Nan::New<Number>(MODE_CBREAK));
+    Nan::Set(modes, Nan::New<String>("COOKED").ToLocalChecked(), Nan::New<Number>(MODE_COOKED));
+    #ifdef TERMIOS_HAS_CFMAKERAW
+    Nan::Set(modes, Nan::New<String>("CFMAKERAW").ToLocalChecked(), Nan::New<Number>(MODE_CFMAKERAW));
+    #endif
+    Nan::Set(modes, Nan::New<String>("SNAPSHOT").ToLocalChecked(), Nan::New<Number>(MODE_SNAPSHOT));
+    MODULE_EXPORT("MODE", modes);
+    MODULE_EXPORT("apply_mode", Nan::GetFunction(Nan::New<FunctionTemplate>(ApplyMode)).ToLocalChecked());
+    MODULE_EXPORT("setmode", Nan::GetFunction(Nan::New<FunctionTemplate>(SetMode)).ToLocalChecked());
+}
@@ -0,0 +1,61 @@
+/* termios_stty.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TERMIOS_STTY_H
+#define TERMIOS_STTY_H
+
+#include "node_termios.h"
+#include <stdint.h>
+#include <string>
+
+#define TERMIOS_PATCH_MAGIC 0x54505431  // "TPT1"
+
+/**
+ * Termios patch - precompiled stty like settings.
+ *
+ * Holds set and clear masks for every flag word (applied as
+ * `(flags & ~clear) | set`), c_cc overrides and an optional speed.
+ * The struct is handed to JS as opaque buffer.
+ */
+struct TermiosPatch {
+    uint32_t magic;
+    uint32_t set[4];        // c_iflag, c_oflag, c_cflag, c_lflag
+    uint32_t clear[4];
+    uint32_t rate;          // bit rate, 0 for unchanged
+    uint8_t cc_mask[NCCS];  // non zero for overridden c_cc entries
+    cc_t cc[NCCS];
+};
+
+// compile `spec` into `patch`, returns false with a message in `error` on failure
+bool stty_compile(const char *spec, TermiosPatch *patch, std::string *error);
+
+// apply `patch` to `attrs`, returns 0 or -1 with errno set (speed failures)
+int stty_apply(const TermiosPatch *patch, struct termios *attrs);
+
+// mode presets of setmode
+#define MODE_RAW 0
+#define MODE_CBREAK 1
+#define MODE_COOKED 2
+#define MODE_CFMAKERAW 3
+#define MODE_SNAPSHOT 4
+
+// cfmakeraw is missing on Solaris
+#if !defined(__sun)
+#define TERMIOS_HAS_CFMAKERAW
+#endif
+
+// apply mode `preset` to `attrs`, returns false for unknown or unsupported presets
+bool mode_apply(int preset, struct termios *attrs);
+
+NAN_METHOD(SttyCompile);
+NAN_METHOD(SttyApply);
+NAN_METHOD(SttyDescribe);
+NAN_METHOD(ApplyMode);
+NAN_METHOD(SetMode);
+NAN_MODULE_INIT(InitMode);
+
+#endif // TERMIOS_STTY_H
@@ -0,0 +1,457 @@
+/* termios_symbols.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "termios_symbols.h"
+#include <string.h>
+#include <sys/ioctl.h>
+
+#define SYMBOL(sym) {#sym, (uint32_t) (sym)}
+
+// no platform switches here, simply test for existance of questionable symbols
+// _SAFE32 macro is used as a compile guard to spot symbol changes beyond 32 bit
+
+// c_iflag
+static const SymbolEntry iflag_symbols[] = {
+    #if    _SAFE32_8(IGNBRK,BRKINT,IGNPAR,PARMRK,INPCK,ISTRIP,INLCR,ICRNL) \
+        && _SAFE32_8(IUCLC,IXON,IXANY,IXOFF,IMAXBEL,IUTF8,0,0)
+
+    SYMBOL(IGNBRK),
+    SYMBOL(BRKINT),
+    SYMBOL(IGNPAR),
+    SYMBOL(PARMRK),
+    SYMBOL(INPCK),
+    SYMBOL(ISTRIP),
+    SYMBOL(INLCR),
+    SYMBOL(IGNCR),
+    SYMBOL(ICRNL),
+    #ifdef IUCLC
+    SYMBOL(IUCLC),
+    #endif
+    SYMBOL(IXON),
+    SYMBOL(IXANY),
+    SYMBOL(IXOFF),
+    SYMBOL(IMAXBEL),
+    #ifdef IUTF8
+    SYMBOL(IUTF8),
+    #endif
+
+    #else
+    #error "iflag not in 32 bit range"
+    #endif
+    {NULL, 0}
+};
+
+
+// c_oflag
+static const SymbolEntry oflag_symbols[] = {
+    #if    _SAFE32_8(OPOST,OLCUC,ONLCR,OCRNL,ONOCR,ONLRET,OFILL,OFDEL) \
+        && _SAFE32_8(NLDLY,CRDLY,TABDLY,BSDLY,VTDLY,FFDLY,TAB0,TAB3)   \
+        && _SAFE32_1(ONOEOT)
+
+    SYMBOL(OPOST),
+    #ifdef OLCUC
+    SYMBOL(OLCUC),
+    #endif
+    SYMBOL(ONLCR),
+    SYMBOL(OCRNL),
+    SYMBOL(ONOCR),
+    SYMBOL(ONLRET),
+    #ifdef OFILL
+    SYMBOL(OFILL),
+    #endif
+    #ifdef OFDEL
+    SYMBOL(OFDEL),
+    #endif
+    #ifdef NLDLY
+    SYMBOL(NLDLY),
+    #endif
+    #ifdef CRDLY
+    SYMBOL(CRDLY),
+    #endif
+    #ifdef TABDLY
+    SYMBOL(TABDLY),
+    #endif
+    #ifdef BSDLY
+    SYMBOL(BSDLY),
+    #endif
+    #ifdef VTDLY
+    SYMBOL(VTDLY),
+    #endif
+    #ifdef FFDLY
+    SYMBOL(FFDLY),
+    #endif
+    #ifdef TAB0
+    SYMBOL(TAB0),
+    #endif
+    #ifdef TAB3
+    SYMBOL(TAB3),
+    #endif
+    #ifdef ONOEOT
+    SYMBOL(ONOEOT),
+    #endif
+
+    #else
+    #error "oflag not in 32 bit range"
+    #endif
+    {NULL, 0}
+};
+
+
+// c_cflag
+static const SymbolEntry cflag_symbols[] = {
+    #if    _SAFE32_8(CBAUD,CBAUDEX,CSIZE,CS5,CS6,CS7,CS8,CSTOPB)           \
+        && _SAFE32_8(CREAD,PARENB,PARODD,HUPCL,CLOCAL,LOBLK,CIBAUD,CMSPAR) \
+        && _SAFE32_4(CRTSCTS,CCTS_OFLOW,CRTS_IFLOW,MDMBUF)
+
+    #ifdef CBAUD
+    SYMBOL(CBAUD),
+    #endif
+    #ifdef CBAUDEX
+    SYMBOL(CBAUDEX),
+    #endif
+    SYMBOL(CSIZE),
+    SYMBOL(CS5),
+    SYMBOL(CS6),
+    SYMBOL(CS7),
+    SYMBOL(CS8),
+    SYMBOL(CSTOPB),
+    SYMBOL(CREAD),
+    SYMBOL(PARENB),
+    SYMBOL(PARODD),
+    SYMBOL(HUPCL),
+    SYMBOL(CLOCAL),
+    #ifdef LOBLK
+    SYMBOL(LOBLK),
+    #endif
+    #ifdef CIBAUD
+    SYMBOL(CIBAUD),
+    #endif
+    #ifdef CMSPAR
+    SYMBOL(CMSPAR),
+    #endif
+    SYMBOL(CRTSCTS),
+    #ifdef CCTS_OFLOW
+    SYMBOL(CCTS_OFLOW),
+    #endif
+    #ifdef CRTS_IFLOW
+    SYMBOL(CRTS_IFLOW),
+    #endif
+    #ifdef MDMBUF
+    SYMBOL(MDMBUF),
+    #endif
+
+    #else
+    #error "cflag not in 32 bit range"
+    #endif
+    {NULL, 0}
+};
+
+
+// c_lflag
+static const SymbolEntry lflag_symbols[] = {
+    #if    _SAFE32_8(ISIG,ICANON,XCASE,ECHO,ECHOE,ECHOK,ECHONL,ECHOCTL)         \
+        && _SAFE32_8(ECHOPRT,ECHOKE,DEFECHO,FLUSHO,NOFLSH,TOSTOP,PENDIN,IEXTEN) \
+        && _SAFE32_4(ALTWERASE,EXTPROC,NOKERNINFO,0)
+
+    SYMBOL(ISIG),
+    SYMBOL(ICANON),
+    #ifdef XCASE
+    SYMBOL(XCASE),
+    #endif
+    SYMBOL(ECHO),
+    SYMBOL(ECHOE),
+    #ifdef ECHOK
+    SYMBOL(ECHOK),
+    #endif
+    SYMBOL(ECHONL),
+    SYMBOL(ECHOCTL),
+    SYMBOL(ECHOPRT),
+    SYMBOL(ECHOKE),
+    #ifdef DEFECHO
+    SYMBOL(DEFECHO),
+    #endif
+    SYMBOL(FLUSHO),
+    SYMBOL(NOFLSH),
+    SYMBOL(TOSTOP),
+    SYMBOL(PENDIN),
+    SYMBOL(IEXTEN),
+    #ifdef ALTWERASE
+    SYMBOL(ALTWERASE),
+    #endif
+    #ifdef EXTPROC
+    SYMBOL(EXTPROC),
+    #endif
+    #ifdef NOKERNINFO
+    SYMBOL(NOKERNINFO),
+    #endif
+
+    #else
+    #error "lflag not in 32 bit range"
+    #endif
+    {NULL, 0}
+};
+
+
+// c_cc
+static const SymbolEntry cc_symbols[] = {
+    SYMBOL(VDISCARD),
+    #ifdef VDSUSP
+    SYMBOL(VDSUSP),
+    #endif
+    SYMBOL(VEOF),
+    SYMBOL(VEOL),
+    SYMBOL(VEOL2),
+    SYMBOL(VERASE),
+    SYMBOL(VINTR),
+    SYMBOL(VKILL),
+    SYMBOL(VLNEXT),
+    SYMBOL(VMIN),
+    SYMBOL(VQUIT),
+    SYMBOL(VREPRINT),
+    SYMBOL(VSTART),
+    #ifdef VSTATUS
+    SYMBOL(VSTATUS),
+    #endif
+    SYMBOL(VSTOP),
+    SYMBOL(VSUSP),
+    #ifdef VSWTCH
+    SYMBOL(VSWTCH),
+    #endif
+    SYMBOL(VTIME),
+    SYMBOL(VWERASE),
+    {NULL, 0}
+};
+
+
+// optional_actions for tcsetattr
+static const SymbolEntry action_symbols[] = {
+    SYMBOL(TCSANOW),
+    SYMBOL(TCSADRAIN),
+    SYMBOL(TCSAFLUSH),
+    #ifdef TCSASOFT
+    SYMBOL(TCSASOFT),
+    #endif
+    {NULL, 0}
+};
+
+
+// tcflush queue_selectors
+static const SymbolEntry flush_symbols[] = {
+    SYMBOL(TCIFLUSH),
+    SYMBOL(TCOFLUSH),
+    SYMBOL(TCIOFLUSH),
+    {NULL, 0}
+};
+
+
+// tcflow actions
+static const SymbolEntry flow_symbols[] = {
+    SYMBOL(TCOOFF),
+    SYMBOL(TCOON),
+    SYMBOL(TCIOFF),
+    SYMBOL(TCION),
+    {NULL, 0}
+};
+
+
+// baud rates
+static const SymbolEntry baud_symbols[] = {
+    SYMBOL(B0),
+    SYMBOL(B50),
+    SYMBOL(B75),
+    SYMBOL(B110),
+    SYMBOL(B134),
+    SYMBOL(B150),
+    SYMBOL(B200),
+    SYMBOL(B300),
+    SYMBOL(B600),
+    SYMBOL(B1200),
+    SYMBOL(B1800),
+    SYMBOL(B2400),
+    SYMBOL(B4800),
+    SYMBOL(B9600),
+    SYMBOL(B19200),
+    SYMBOL(B38400),
+    #ifdef B7200
+    SYMBOL(B7200),
+    #endif
+    #ifdef B14400
+    SYMBOL(B14400),
+    #endif
+    #ifdef B28800
+    SYMBOL(B28800),
+    #endif
+    SYMBOL(B57600),
+    #ifdef B76800
+    SYMBOL(B76800),
+    #endif
+    SYMBOL(B115200),
+    SYMBOL(B230400),
+    #ifdef B460800
+    SYMBOL(B460800),
+    #endif
+    #ifdef B500000
+    SYMBOL(B500000),
+    #endif
+    #ifdef B576000
+    SYMBOL(B576000),
+    #endif
+    #ifdef B921600
+    SYMBOL(B921600),
+    #endif
+    #ifdef B1000000
+    SYMBOL(B1000000),
+    #endif
+    #ifdef B1152000
+    SYMBOL(B1152000),
+    #endif
+    #ifdef B1500000
+    SYMBOL(B1500000),
+    #endif
+    #ifdef B2000000
+    SYMBOL(B2000000),
+    #endif
+    #ifdef B2500000
+    SYMBOL(B2500000),
+    #endif
+    #ifdef B3000000
+    SYMBOL(B3000000),
+    #endif
+    #ifdef B3500000
+    SYMBOL(B3500000),
+    #endif
+    #ifdef B4000000
+    SYMBOL(B4000000),
+    #endif
+    #ifdef EXTA
+    SYMBOL(EXTA),
+    #endif
+    #ifdef EXTB
+    SYMBOL(EXTB),
+    #endif
+    {NULL, 0}
+};
+
+
+// pty packet mode control bytes
+static const SymbolEntry packet_symbols[] = {
+    #ifdef TIOCPKT
+    SYMBOL(TIOCPKT_DATA),
+    SYMBOL(TIOCPKT_FLUSHREAD),
+    SYMBOL(TIOCPKT_FLUSHWRITE),
+    SYMBOL(TIOCPKT_STOP),
+    SYMBOL(TIOCPKT_START),
+    SYMBOL(TIOCPKT_NOSTOP),
+    SYMBOL(TIOCPKT_DOSTOP),
+    #ifdef TIOCPKT_IOCTL
+    SYMBOL(TIOCPKT_IOCTL),
+    #endif
+    #endif
+    {NULL, 0}
+};
+
+
+const SymbolGroup symbol_groups[] = {
+    {"IFLAGS", iflag_symbols},
+    {"OFLAGS", oflag_symbols},
+    {"CFLAGS", cflag_symbols},
+    {"LFLAGS", lflag_symbols},
+    {"CC", cc_symbols},
+    {"ACTION", action_symbols},
+    {"FLUSH", flush_symbols},
+    {"FLOW", flow_symbols},
+    {"BAUD", baud_symbols},
+    {"PKT", packet_symbols},
+    {NULL, NULL}
+};
+
+
+const SymbolEntry *termios_symbol(const char *group, const char *name)
+{
+    for (const SymbolGroup *g = symbol_groups; g->name; ++g) {
+        if (group && strcmp(group, g->name)) {
+            continue;
+        }
+        for (const SymbolEntry *entry = g->entries; entry->name; ++entry) {
+            if (!strcmp(entry->name, name)) {
+                return entry;
+            }
+        }
+    }
+    return NULL;
+}
+
+
+static void add_symbols(Local<Object> target, const SymbolEntry *entries)
+{
+    for (const SymbolEntry *entry = entries; entry->name; ++entry) {
+        Nan::Set(target, Nan::New<String>(entry->name).ToLocalChecked(), Nan::New<Number>(entry->value));
+    }
+}
+
+
+static Local<Object> explain_termios()
+{
+    // EXPLAIN_MEMBERS --> {symbol: {offset: 0, width: 4}}
+    Local<Object> members = Nan::New<Object>();
+    EXPLAIN_MEMBER(members, struct termios, c_iflag);
+    EXPLAIN_MEMBER(members, struct termios, c_oflag);
+    EXPLAIN_MEMBER(members, struct termios, c_cflag);
+    EXPLAIN_MEMBER(members, struct termios, c_lflag);
+    EXPLAIN_MEMBER_ARRAY(members, struct termios, c_cc, cc_t);
+
+    Local<Object> termios_explain = Nan::New<Object>();
+    Nan::Set(termios_explain, Nan::New<String>("size").ToLocalChecked(), Nan::New<Number>(sizeof(struct termios)));
+    Nan::Set(termios_explain, Nan::New<String>("members").ToLocalChecked(), members);
+    return termios_explain;
+}
+
+
+// index values in accessor data besides the group index
+#define SYMBOLS_ALL -1
+#define SYMBOLS_EXPLAIN -2
+
+/**
+ * Materialize a symbol object on first access.
+ * The accessor gets replaced by a plain data property holding the object,
+ * thus later reads are normal property loads.
+ */
+static NAN_GETTER(SymbolGetter)
+{
+    int index = Nan::To<int>(info.Data()).FromJust();
+    Local<Object> result;
+    if (index == SYMBOLS_EXPLAIN) {
+        result = explain_termios();
+    } else {
+        result = Nan::New<Object>();
+        for (int i = 0; symbol_groups[i].name; ++i) {
+            if (index == SYMBOLS_ALL || index == i) {
+                add_symbols(result, symbol_groups[i].entries);
+            }
+        }
+    }
+    Nan::DefineOwnProperty(info.This(), property, result);
+    info.GetReturnValue().Set(result);
+}
+
+
+NAN_MODULE_INIT(InitSymbols)
+{
+    // The symbols are grouped together by responsibility.
+    // Additonally all known symbols can be found in `ALL_SYMBOLS`.
+    Local<Array> names = Nan::New<Array>();
+    for (int i = 0; symbol_groups[i].name; ++i) {
+        Nan::SetAccessor(target, Nan::New<String>(symbol_groups[i].name).ToLocalChecked(),
+                         SymbolGetter, 0, Nan::New<Number>(i));
+        Nan::Set(names, i, Nan::New<String>(symbol_groups[i].name).ToLocalChecked());
+    }
+    Nan::SetAccessor(target, Nan::New<String>("ALL_SYMBOLS").ToLocalChecked(),
+                     SymbolGetter, 0, Nan::New<Number>(SYMBOLS_ALL));
+    Nan::SetAccessor(target, Nan::New<String>("EXPLAIN").ToLocalChecked(),
+                     SymbolGetter, 0, Nan::New<Number>(SYMBOLS_EXPLAIN));
+    MODULE_EXPORT("SYMBOL_GROUPS", names);
+}
@@ -0,0 +1,39 @@
+/* termios_symbols.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TERMIOS_SYMBOLS_H
+#define TERMIOS_SYMBOLS_H
+
+#include "node_termios.h"
+#include <stdint.h>
+
+/**
+ * Static symbol tables.
+ *
+ * Every group is a {name, value} list terminated by a NULL name,
+ * `symbol_groups` is terminated by a NULL group name.
+ * The JS objects (IFLAGS, ..., ALL_SYMBOLS, EXPLAIN) are only
+ * created on first access.
+ */
+struct SymbolEntry {
+    const char *name;
+    uint32_t value;
+};
+
+struct SymbolGroup {
+    const char *name;
+    const SymbolEntry *entries;
+};
+
+extern const SymbolGroup symbol_groups[];
+
+// lookup symbol by name, `group` may be NULL to search all groups
+const SymbolEntry *termios_symbol(const char *group, const char *name);
+
+NAN_MODULE_INIT(InitSymbols);
+
+#endif // TERMIOS_SYMBOLS_H
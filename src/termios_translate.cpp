@@ -0,0 +1,319 @@
+/* termios_translate.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "termios_translate.h"
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define TRANSLATE_SIMD
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TRANSLATE_SIMD
+#endif
+
+#ifndef OLCUC
+#define OLCUC 0
+#endif
+#ifndef IUCLC
+#define IUCLC 0
+#endif
+#ifndef IUTF8
+#define IUTF8 0
+#endif
+
+
+/**
+ * Byte classes of a translation.
+ *
+ * Bytes equal to `special1` / `special2` (or all control and non ASCII bytes
+ * with `track` set) need scalar handling, all other bytes get copied
+ * after masking with `strip` and flipping the case of [case_lo, case_hi].
+ */
+struct Rules {
+    tcflag_t flags;
+    tcflag_t iflags;
+    uint8_t strip;
+    uint8_t case_lo;
+    uint8_t case_hi;
+    int special1;
+    int special2;
+    bool track;
+};
+
+
+#ifdef TRANSLATE_SIMD
+/**
+ * Translate 16 bytes at `in` to `out` without the specials.
+ * Returns 0 if the whole block was fine, otherwise a mask,
+ * that `first_special` turns into the index of the first special byte.
+ */
+#if defined(__SSE2__)
+static inline uint32_t translate_block(const uint8_t *in, uint8_t *out, const Rules &rules)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *) in);
+    v = _mm_and_si128(v, _mm_set1_epi8((char) rules.strip));
+    if (rules.case_lo) {
+        // signed compares - bytes >= 0x80 never fall into the ASCII range
+        __m128i in_range = _mm_and_si128(
+            _mm_cmpgt_epi8(v, _mm_set1_epi8((char) (rules.case_lo - 1))),
+            _mm_cmplt_epi8(v, _mm_set1_epi8((char) (rules.case_hi + 1))));
+        v = _mm_xor_si128(v, _mm_and_si128(in_range, _mm_set1_epi8(0x20)));
+    }
+    _mm_storeu_si128((__m128i *) out, v);
+    __m128i special = _mm_setzero_si128();
+    if (rules.track) {
+        // C0 controls, DEL and everything >= 0x80 (negative)
+        special = _mm_or_si128(_mm_cmplt_epi8(v, _mm_set1_epi8(0x20)), _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F)));
+    } else {
+        if (rules.special1 >= 0) {
+            special = _mm_cmpeq_epi8(v, _mm_set1_epi8((char) rules.special1));
+        }
+        if (rules.special2 >= 0) {
+            special = _mm_or_si128(special, _mm_cmpeq_epi8(v, _mm_set1_epi8((char) rules.special2)));
+        }
+    }
+    return (uint32_t) _mm_movemask_epi8(special);
+}
+
+static inline int first_special(uint32_t mask)
+{
+    return __builtin_ctz(mask);
+}
+#else
+static inline uint32_t translate_block(const uint8_t *in, uint8_t *out, const Rules &rules)
+{
+    uint8x16_t v = vandq_u8(vld1q_u8(in), vdupq_n_u8(rules.strip));
+    if (rules.case_lo) {
+        uint8x16_t in_range = vandq_u8(vcgeq_u8(v, vdupq_n_u8(rules.case_lo)), vcleq_u8(v, vdupq_n_u8(rules.case_hi)));
+        v = veorq_u8(v, vandq_u8(in_range, vdupq_n_u8(0x20)));
+    }
+    vst1q_u8(out, v);
+    uint8x16_t special = vdupq_n_u8(0);
+    if (rules.track) {
+        special = vorrq_u8(vcltq_u8(v, vdupq_n_u8(0x20)), vcgeq_u8(v, vdupq_n_u8(0x7F)));
+    } else {
+        if (rules.special1 >= 0) {
+            special = vceqq_u8(v, vdupq_n_u8((uint8_t) rules.special1));
+        }
+        if (rules.special2 >= 0) {
+            special = vorrq_u8(special, vceqq_u8(v, vdupq_n_u8((uint8_t) rules.special2)));
+        }
+    }
+    // narrow to 4 bits per byte - 64 bit mask, 0 without any special
+    uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(special), 4)), 0);
+    return mask ? (uint32_t) (__builtin_ctzll(mask) >> 2) + 1 : 0;
+}
+
+static inline int first_special(uint32_t mask)
+{
+    return (int) mask - 1;
+}
+#endif
+#endif
+
+
+// iscntrl of the kernel (latin1: C0, DEL and C1)
+static inline bool is_control(uint8_t c)
+{
+    return c < 0x20 || (c >= 0x7F && c < 0xA0);
+}
+
+
+// scalar output rules, returns the number of bytes written
+static inline size_t output_char(uint8_t c, uint8_t *out, uint32_t *column, const Rules &rules)
+{
+    tcflag_t flags = rules.flags;
+    switch (c) {
+        case '\n':
+            if (flags & ONLRET) {
+                *column = 0;
+            }
+            if (flags & ONLCR) {
+                *column = 0;
+                out[0] = '\r';
+                out[1] = '\n';
+                return 2;
+            }
+            break;
+        case '\r':
+            if ((flags & ONOCR) && *column == 0) {
+                return 0;
+            }
+            if (flags & OCRNL) {
+                c = '\n';
+                if (flags & ONLRET) {
+                    *column = 0;
+                }
+                break;
+            }
+            *column = 0;
+            break;
+        case '\t':
+            *column += 8 - (*column & 7);
+            break;
+        case '\b':
+            if (*column > 0) {
+                (*column)--;
+            }
+            break;
+        default:
+            if (!is_control(c)) {
+                if (c >= 'a' && c <= 'z' && (flags & OLCUC)) {
+                    c -= 0x20;
+                }
+                if (!((rules.iflags & IUTF8) && (c & 0xC0) == 0x80)) {
+                    (*column)++;
+                }
+            }
+    }
+    out[0] = c;
+    return 1;
+}
+
+
+// scalar input rules, returns the number of bytes written
+static inline size_t input_char(uint8_t c, uint8_t *out, const Rules &rules)
+{
+    tcflag_t flags = rules.flags;
+    c &= rules.strip;
+    if (c >= 'A' && c <= 'Z' && (flags & IUCLC)) {
+        c += 0x20;
+    }
+    if (c == '\r') {
+        if (flags & IGNCR) {
+            return 0;
+        }
+        if (flags & ICRNL) {
+            c = '\n';
+        }
+    } else if (c == '\n' && (flags & INLCR)) {
+        c = '\r';
+    }
+    out[0] = c;
+    return 1;
+}
+
+
+size_t termios_translate(const struct termios *attrs, int direction,
+                         const uint8_t *in, size_t len, uint8_t *out, uint32_t *column)
+{
+    Rules rules;
+    rules.iflags = attrs->c_iflag;
+    rules.strip = 0xFF;
+    rules.case_lo = 0;
+    rules.case_hi = 0;
+    rules.special1 = -1;
+    rules.special2 = -1;
+    rules.track = false;
+    bool output = direction == TRANSLATE_OUTPUT;
+    if (output) {
+        rules.flags = attrs->c_oflag;
+        if (!(rules.flags & OPOST)) {
+            memcpy(out, in, len);
+            return len;
+        }
+        if (rules.flags & OLCUC) {
+            rules.case_lo = 'a';
+            rules.case_hi = 'z';
+        }
+        // the column is only of interest for ONOCR
+        rules.track = rules.flags & ONOCR;
+        if (rules.flags & ONLCR) {
+            rules.special1 = '\n';
+        }
+        if (rules.flags & OCRNL) {
+            rules.special2 = '\r';
+        }
+    } else {
+        rules.flags = attrs->c_iflag;
+        if (rules.flags & ISTRIP) {
+            rules.strip = 0x7F;
+        }
+        if (rules.flags & IUCLC) {
+            rules.case_lo = 'A';
+            rules.case_hi = 'Z';
+        }
+        if (rules.flags & (IGNCR | ICRNL)) {
+            rules.special1 = '\r';
+        }
+        if (rules.flags & INLCR) {
+            rules.special2 = '\n';
+        }
+    }
+
+    size_t i = 0;
+    uint8_t *start = out;
+    while (i < len) {
+        #ifdef TRANSLATE_SIMD
+        // skip runs without special bytes 16 bytes at once
+        if (len - i >= 16) {
+            uint32_t mask = translate_block(in + i, out, rules);
+            if (!mask) {
+                i += 16;
+                out += 16;
+                if (rules.track) {
+                    *column += 16;
+                }
+                continue;
+            }
+            int skip = first_special(mask);
+            i += skip;
+            out += skip;
+            if (rules.track) {
+                *column += skip;
+            }
+        }
+        #endif
+        uint8_t c = in[i++];
+        out += output ? output_char(c, out, column, rules) : input_char(c, out, rules);
+    }
+    return out - start;
+}
+
+
+/**
+ * Apply the line discipline translations to a chunk of data.
+ * `output` must hold 2 * input.length bytes (TRANSLATE.OUTPUT) or
+ * input.length bytes (TRANSLATE.INPUT). `state` (4 bytes) carries the
+ * output column across chunk boundaries.
+ * Returns the number of bytes written to `output`.
+ */
+NAN_METHOD(Translate)
+{
+    if (info.Length() < 4 || info.Length() > 5 || !info[1]->IsInt32()
+            || !Buffer::HasInstance(info[2]) || !Buffer::HasInstance(info[3])) {
+        return Nan::ThrowError("usage: termios.translate(buffer, direction, input, output, state?)");
+    }
+    const struct termios *attrs = termios_arg(info[0]);
+    if (!attrs) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    int direction = int32_arg(info[1]);
+    if (direction != TRANSLATE_OUTPUT && direction != TRANSLATE_INPUT) {
+        return Nan::ThrowError("translate failed - unknown direction");
+    }
+    size_t len = Buffer::Length(info[2]);
+    if (Buffer::Length(info[3]) < (direction == TRANSLATE_OUTPUT ? 2 * len : len)) {
+        return Nan::ThrowError("translate failed - output too small");
+    }
+    uint32_t column = 0;
+    char *state = NULL;
+    if (info.Length() == 5) {
+        if (!Buffer::HasInstance(info[4]) || Buffer::Length(info[4]) < sizeof(uint32_t)) {
+            return Nan::ThrowError("wrong buffer type");
+        }
+        state = Buffer::Data(info[4]);
+        memcpy(&column, state, sizeof(uint32_t));
+    }
+    size_t written = termios_translate(attrs, direction, (const uint8_t *) Buffer::Data(info[2]), len,
+                                       (uint8_t *) Buffer::Data(info[3]), &column);
+    if (state) {
+        memcpy(state, &column, sizeof(uint32_t));
+    }
+    info.GetReturnValue().Set((double) written);
+}
@@ -0,0 +1,32 @@
+/* termios_translate.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TERMIOS_TRANSLATE_H
+#define TERMIOS_TRANSLATE_H
+
+#include "node_termios.h"
+#include <stdint.h>
+
+#define TRANSLATE_OUTPUT 0
+#define TRANSLATE_INPUT 1
+
+/**
+ * Apply the line discipline translations of `attrs` to `len` bytes of `in`.
+ *
+ * TRANSLATE_OUTPUT applies the c_oflag rules (OPOST, ONLCR, OCRNL, ONOCR,
+ * ONLRET, OLCUC), `out` must hold 2 * len bytes. `column` carries the
+ * output column between calls (needed for ONOCR).
+ * TRANSLATE_INPUT applies the c_iflag rules (ISTRIP, IUCLC, IGNCR, ICRNL, INLCR),
+ * `out` must hold len bytes.
+ * Returns the number of bytes written to `out`.
+ */
+size_t termios_translate(const struct termios *attrs, int direction,
+                         const uint8_t *in, size_t len, uint8_t *out, uint32_t *column);
+
+NAN_METHOD(Translate);
+
+#endif // TERMIOS_TRANSLATE_H
@@ -0,0 +1,309 @@
+/* termios_winsize.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "termios_winsize.h"
+#include "termios_basic.h"
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+
+struct WinsizeEntry {
+    uint32_t generation;
+    dev_t tty_dev;      // tty behind the fd (see termios_tty_id)
+    ino_t tty_ino;
+    struct winsize ws;
+};
+
+static std::atomic<bool> winsize_enabled(false);
+static std::atomic<uint32_t> winsize_generation(0);
+static std::atomic<uint64_t> winsize_hits(0);
+static std::atomic<uint64_t> winsize_misses(0);
+static std::mutex winsize_mutex;
+static std::unordered_map<int, WinsizeEntry> winsize_cache;
+
+// SIGWINCH watcher, lives on the loop of the thread that enabled the cache
+static std::mutex watcher_mutex;
+static uv_signal_t *winch_watcher = NULL;
+static uv_loop_t *winch_loop = NULL;
+
+
+// needs winsize_mutex
+static void drop_tty(dev_t tty_dev, ino_t tty_ino)
+{
+    for (auto it = winsize_cache.begin(); it != winsize_cache.end();) {
+        if (it->second.tty_dev == tty_dev && it->second.tty_ino == tty_ino) {
+            it = winsize_cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+
+/**
+ * Store the window size of fd. With `changed` the size of the tty was just
+ * set, entries of other fds on the same tty (e.g. the slave of a resized
+ * pty master) are dropped, since no SIGWINCH reaches this process for them.
+ */
+static void store_entry(int fd, const struct winsize *ws, bool changed)
+{
+    dev_t tty_dev;
+    ino_t tty_ino;
+    bool identified = !termios_tty_id(fd, &tty_dev, &tty_ino);
+    std::lock_guard<std::mutex> lock(winsize_mutex);
+    if (!identified) {
+        winsize_cache.erase(fd);
+        return;
+    }
+    if (changed) {
+        drop_tty(tty_dev, tty_ino);
+    }
+    WinsizeEntry &entry = winsize_cache[fd];
+    entry.generation = winsize_generation.load();
+    entry.tty_dev = tty_dev;
+    entry.tty_ino = tty_ino;
+    entry.ws = *ws;
+}
+
+
+int termios_getwinsize(int fd, struct winsize *ws)
+{
+    if (winsize_enabled.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(winsize_mutex);
+        auto it = winsize_cache.find(fd);
+        if (it != winsize_cache.end() && it->second.generation == winsize_generation.load()) {
+            *ws = it->second.ws;
+            winsize_hits++;
+            return 0;
+        }
+    }
+    winsize_misses++;
+    int res;
+    TEMP_FAILURE_RETRY(res = ioctl(fd, TIOCGWINSZ, ws));
+    if (res == -1) {
+        return -1;
+    }
+    if (winsize_enabled.load(std::memory_order_relaxed)) {
+        store_entry(fd, ws, false);
+    }
+    return 0;
+}
+
+
+int termios_setwinsize(int fd, const struct winsize *ws)
+{
+    int res;
+    TEMP_FAILURE_RETRY(res = ioctl(fd, TIOCSWINSZ, ws));
+    if (!winsize_enabled.load(std::memory_order_relaxed)) {
+        return res;
+    }
+    if (res == -1) {
+        int err = errno;
+        std::lock_guard<std::mutex> lock(winsize_mutex);
+        winsize_cache.erase(fd);
+        errno = err;
+        return -1;
+    }
+    store_entry(fd, ws, true);
+    return 0;
+}
+
+
+static struct winsize *winsize_arg(Local<Value> value, size_t count)
+{
+    if (!Buffer::HasInstance(value) || Buffer::Length(value) != count * sizeof(struct winsize)) {
+        return NULL;
+    }
+    return (struct winsize *) Buffer::Data(value);
+}
+
+
+/**
+ * Load the window size of `fd` into `buffer` (ws_row, ws_col, ws_xpixel, ws_ypixel
+ * as unsigned short in native byte order).
+ */
+NAN_METHOD(Getwinsize)
+{
+    if (info.Length() != 2 || !info[0]->IsInt32()) {
+        return Nan::ThrowError("usage: termios.getwinsize(fd, buffer)");
+    }
+    struct winsize *ws = winsize_arg(info[1], 1);
+    if (!ws) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    if (termios_getwinsize(int32_arg(info[0]), ws)) {
+        std::string error(strerror(errno));
+        return Nan::ThrowError((std::string("getwinsize failed - ") + error).c_str());
+    }
+}
+
+
+NAN_METHOD(Setwinsize)
+{
+    if (info.Length() < 3 || info.Length() > 5) {
+        return Nan::ThrowError("usage: termios.setwinsize(fd, rows, cols, xpixel?, ypixel?)");
+    }
+    for (int i = 0; i < info.Length(); ++i) {
+        if (!info[i]->IsInt32() || (i && (int32_arg(info[i]) < 0 || int32_arg(info[i]) > 0xFFFF))) {
+            return Nan::ThrowError("usage: termios.setwinsize(fd, rows, cols, xpixel?, ypixel?)");
+        }
+    }
+    struct winsize ws;
+    ws.ws_row = int32_arg(info[1]);
+    ws.ws_col = int32_arg(info[2]);
+    ws.ws_xpixel = (info.Length() > 3) ? int32_arg(info[3]) : 0;
+    ws.ws_ypixel = (info.Length() > 4) ? int32_arg(info[4]) : 0;
+    if (termios_setwinsize(int32_arg(info[0]), &ws)) {
+        std::string error(strerror(errno));
+        return Nan::ThrowError((std::string("setwinsize failed - ") + error).c_str());
+    }
+}
+
+
+/**
+ * Resize many fds at once. `buffer` holds fds.length window sizes
+ * (layout as in getwinsize). Returns 0 or the negative errno value for every fd.
+ */
+NAN_METHOD(SetwinsizeMany)
+{
+    if (info.Length() != 2 || !info[0]->IsArray()) {
+        return Nan::ThrowError("usage: termios.setwinsize_many(fds, buffer)");
+    }
+    Local<Array> fds = info[0].As<Array>();
+    uint32_t count = fds->Length();
+    struct winsize *ws = winsize_arg(info[1], count);
+    if (!ws) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    Local<Array> result = Nan::New<Array>(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        int fd = Nan::To<int>(Nan::Get(fds, i).ToLocalChecked()).FromMaybe(-1);
+        Nan::Set(result, i, Nan::New<Number>(termios_setwinsize(fd, ws + i) ? -errno : 0));
+    }
+    info.GetReturnValue().Set(result);
+}
+
+
+static void on_winch(uv_signal_t *handle, int signum)
+{
+    (void) handle;
+    (void) signum;
+    winsize_generation++;
+}
+
+
+// needs watcher_mutex
+static void stop_watcher()
+{
+    uv_signal_stop(winch_watcher);
+    uv_close((uv_handle_t *) winch_watcher, [](uv_handle_t *handle) { delete (uv_signal_t *) handle; });
+    winch_watcher = NULL;
+    winch_loop = NULL;
+}
+
+
+/**
+ * The owning thread (e.g. a worker) exits - the watcher must not outlive
+ * its loop. Without a watcher the cache cannot stay valid, thus it gets
+ * disabled as well.
+ */
+static void on_env_cleanup(void *arg)
+{
+    (void) arg;
+    std::lock_guard<std::mutex> lock(watcher_mutex);
+    if (!winch_watcher) {
+        return;
+    }
+    stop_watcher();
+    winsize_enabled = false;
+    std::lock_guard<std::mutex> cache_lock(winsize_mutex);
+    winsize_cache.clear();
+}
+
+
+/**
+ * Enable the window size cache (default: disabled).
+ * Enabling starts a SIGWINCH watcher on the current event loop
+ * (not keeping the loop alive), disabling clears all entries.
+ * While enabled, the cache belongs to that thread, other threads cannot
+ * switch it. It gets disabled when the owning thread exits.
+ */
+NAN_METHOD(WinsizeCacheEnable)
+{
+    if (info.Length() != 1 || !info[0]->IsBoolean()) {
+        return Nan::ThrowError("usage: termios.winsize_cache_enable(enable)");
+    }
+    bool enable = Nan::To<bool>(info[0]).FromJust();
+    uv_loop_t *loop = Nan::GetCurrentEventLoop();
+    std::lock_guard<std::mutex> lock(watcher_mutex);
+    if (winch_loop && winch_loop != loop) {
+        return Nan::ThrowError("winsize_cache_enable failed - cache is owned by another thread");
+    }
+    if (enable && !winch_watcher) {
+        winch_watcher = new uv_signal_t;
+        uv_signal_init(loop, winch_watcher);
+        uv_signal_start(winch_watcher, on_winch, SIGWINCH);
+        uv_unref((uv_handle_t *) winch_watcher);
+        winch_loop = loop;
+        node::AddEnvironmentCleanupHook(v8::Isolate::GetCurrent(), on_env_cleanup, NULL);
+    } else if (!enable && winch_watcher) {
+        node::RemoveEnvironmentCleanupHook(v8::Isolate::GetCurrent(), on_env_cleanup, NULL);
+        stop_watcher();
+    }
+    if (!enable) {
+        std::lock_guard<std::mutex> lock(winsize_mutex);
+        winsize_cache.clear();
+    }
+    winsize_enabled = enable;
+    info.GetReturnValue().SetUndefined();
+}
+
+
+/**
+ * Invalidate the entries of the tty behind `fd`, or all entries (new generation) if omitted.
+ */
+NAN_METHOD(WinsizeInvalidate)
+{
+    if (info.Length() > 1 || (info.Length() == 1 && !info[0]->IsNumber())) {
+        return Nan::ThrowError("usage: termios.winsize_invalidate(fd?)");
+    }
+    if (info.Length()) {
+        int fd = Nan::To<int>(info[0]).FromJust();
+        dev_t tty_dev;
+        ino_t tty_ino;
+        bool identified = !termios_tty_id(fd, &tty_dev, &tty_ino);
+        std::lock_guard<std::mutex> lock(winsize_mutex);
+        winsize_cache.erase(fd);
+        if (identified) {
+            drop_tty(tty_dev, tty_ino);
+        }
+    } else {
+        winsize_generation++;
+    }
+    info.GetReturnValue().SetUndefined();
+}
+
+
+NAN_METHOD(WinsizeCacheStats)
+{
+    size_t entries;
+    {
+        std::lock_guard<std::mutex> lock(winsize_mutex);
+        entries = winsize_cache.size();
+    }
+    Local<Object> stats = Nan::New<Object>();
+    Nan::Set(stats, Nan::New<String>("enabled").ToLocalChecked(), Nan::New<Boolean>(winsize_enabled.load()));
+    Nan::Set(stats, Nan::New<String>("generation").ToLocalChecked(), Nan::New<Number>(winsize_generation.load()));
+    Nan::Set(stats, Nan::New<String>("hits").ToLocalChecked(), Nan::New<Number>((double) winsize_hits.load()));
+    Nan::Set(stats, Nan::New<String>("misses").ToLocalChecked(), Nan::New<Number>((double) winsize_misses.load()));
+    Nan::Set(stats, Nan::New<String>("entries").ToLocalChecked(), Nan::New<Number>((double) entries));
+    info.GetReturnValue().Set(stats);
+}
@@ -0,0 +1,39 @@
+/* termios_winsize.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TERMIOS_WINSIZE_H
+#define TERMIOS_WINSIZE_H
+
+#include "node_termios.h"
+#include <sys/ioctl.h>
+
+/**
+ * Window size functions with an opt-in cache.
+ *
+ * The cache holds the last window size read from or written to an fd.
+ * Entries are valid for the current generation, which gets bumped by
+ * SIGWINCH (watched on the event loop, that enabled the cache, which owns
+ * the cache until it disables it or exits) and by `winsize_invalidate()`.
+ * Setting a size drops the entries of all other fds on the same tty
+ * (both ends of a pty count as one tty). Thus a cached read costs no
+ * syscall, but size changes made by other parties without a SIGWINCH for
+ * this process (e.g. a pty resized by another process) and fd reuse are
+ * not noticed, invalidate such fds explicitly.
+ */
+
+// TIOCGWINSZ / TIOCSWINSZ through the cache, return 0 or -1 with errno set
+int termios_getwinsize(int fd, struct winsize *ws);
+int termios_setwinsize(int fd, const struct winsize *ws);
+
+NAN_METHOD(Getwinsize);
+NAN_METHOD(Setwinsize);
+NAN_METHOD(SetwinsizeMany);
+NAN_METHOD(WinsizeCacheEnable);
+NAN_METHOD(WinsizeInvalidate);
+NAN_METHOD(WinsizeCacheStats);
+
+#endif // TERMIOS_WINSIZE_H
@@ -0,0 +1,356 @@
+/* tty_framer.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "tty_framer.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <string.h>
+
+#ifdef __linux__
+#define TTY_FRAMER_PPOLL
+#endif
+
+// bytes read per syscall
+#define FRAMER_READ_SIZE 4096
+
+// upper bound of length and max_frame
+#define FRAMER_MAX_FRAME (16 * 1024 * 1024)
+
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static int set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || (!(flags & O_NONBLOCK) && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)) {
+        return -1;
+    }
+    return 0;
+}
+
+
+NAN_MODULE_INIT(TtyFramer::Init)
+{
+    Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New<String>("TtyFramer").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+    Nan::SetPrototypeMethod(tpl, "close", Close);
+    MODULE_EXPORT("TtyFramer", Nan::GetFunction(tpl).ToLocalChecked());
+
+    Local<Object> reasons = Nan::New<Object>();
+    Nan::Set(reasons, Nan::New<String>("GAP").ToLocalChecked(), Nan::New<Number>(FRAME_GAP));
+    Nan::Set(reasons, Nan::New<String>("DELIMITER").ToLocalChecked(), Nan::New<Number>(FRAME_DELIMITER));
+    Nan::Set(reasons, Nan::New<String>("LENGTH").ToLocalChecked(), Nan::New<Number>(FRAME_LENGTH));
+    Nan::Set(reasons, Nan::New<String>("OVERFLOW").ToLocalChecked(), Nan::New<Number>(FRAME_OVERFLOW));
+    Nan::Set(reasons, Nan::New<String>("FLUSH").ToLocalChecked(), Nan::New<Number>(FRAME_FLUSH));
+    MODULE_EXPORT("FRAME", reasons);
+}
+
+
+TtyFramer::TtyFramer(int fd, uint64_t gap, int delimiter, size_t length, size_t max_frame)
+    : fd(fd), gap(gap), delimiter(delimiter), length(length),
+      max_frame((length > max_frame) ? length : max_frame),
+      frame_start(0), last_byte(0), completed(false), ended(false), status(0),
+      closing(false), closed(false), async(NULL), async_resource(NULL)
+{
+    wake_pipe[0] = wake_pipe[1] = -1;
+    // bigger frames grow on demand
+    frame.reserve((this->max_frame < FRAMER_READ_SIZE) ? this->max_frame : FRAMER_READ_SIZE);
+}
+
+
+TtyFramer::~TtyFramer()
+{
+    Shutdown();
+    delete async_resource;
+}
+
+
+/**
+ * new TtyFramer(fd, gap_us, delimiter, length, max_frame, callback)
+ * gap_us 0, delimiter -1 and length 0 disable the rule.
+ * length and max_frame are limited to FRAMER_MAX_FRAME (16 MiB).
+ */
+NAN_METHOD(TtyFramer::New)
+{
+    if (!info.IsConstructCall()) {
+        return Nan::ThrowError("TtyFramer must be called with new");
+    }
+    if (info.Length() != 6 || !info[0]->IsInt32() || !info[1]->IsNumber() || !info[2]->IsInt32()
+            || !info[3]->IsUint32() || !info[4]->IsUint32() || !info[5]->IsFunction()) {
+        return Nan::ThrowError("usage: new termios.TtyFramer(fd, gap_us, delimiter, length, max_frame, callback)");
+    }
+    int fd = int32_arg(info[0]);
+    double gap_us = Nan::To<double>(info[1]).FromJust();
+    int delimiter = int32_arg(info[2]);
+    uint32_t length = Nan::To<uint32_t>(info[3]).FromJust();
+    uint32_t max_frame = Nan::To<uint32_t>(info[4]).FromJust();
+    if (gap_us < 0 || delimiter < -1 || delimiter > 255 || !max_frame
+            || length > FRAMER_MAX_FRAME || max_frame > FRAMER_MAX_FRAME) {
+        return Nan::ThrowError("TtyFramer failed - invalid framing rules");
+    }
+    if (set_nonblocking(fd)) {
+        std::string error(strerror(errno));
+        return Nan::ThrowError((std::string("TtyFramer failed - ") + error).c_str());
+    }
+
+    TtyFramer *framer = new TtyFramer(fd, (uint64_t) (gap_us * 1000), delimiter, length, max_frame);
+    if (pipe(framer->wake_pipe) || set_nonblocking(framer->wake_pipe[0]) || set_nonblocking(framer->wake_pipe[1])) {
+        std::string error(strerror(errno));
+        delete framer;
+        return Nan::ThrowError((std::string("TtyFramer failed - ") + error).c_str());
+    }
+    fcntl(framer->wake_pipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(framer->wake_pipe[1], F_SETFD, FD_CLOEXEC);
+
+    framer->async = new uv_async_t;
+    uv_async_init(Nan::GetCurrentEventLoop(), framer->async, OnAsync);
+    framer->async->data = framer;
+    framer->callback.Reset(info[5].As<Function>());
+    framer->async_resource = new Nan::AsyncResource("termios:TtyFramer");
+    framer->Wrap(info.This());
+    // keep the event loop alive and the JS object pinned until the end is reported
+    framer->Ref();
+    framer->thread = std::thread(&TtyFramer::Run, framer);
+    info.GetReturnValue().Set(info.This());
+}
+
+
+NAN_METHOD(TtyFramer::Close)
+{
+    TtyFramer *framer = Nan::ObjectWrap::Unwrap<TtyFramer>(info.Holder());
+    framer->Shutdown();
+    info.GetReturnValue().SetUndefined();
+}
+
+
+// complete the current frame (reader thread)
+void TtyFramer::Finish(int reason)
+{
+    Frame record = {0, (double) frame.size(), (double) (frame_start / 1000),
+                    (double) (last_byte / 1000), (double) reason};
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        record.offset = (double) pending_data.size();
+        pending_data.append(frame);
+        pending.push_back(record);
+    }
+    frame.clear();
+    completed = true;
+}
+
+
+/**
+ * Split bytes arrived at `now` into frames (reader thread).
+ * Delimiters are searched with memchr, runs without a rule match are appended at once.
+ */
+void TtyFramer::Feed(const char *data, size_t size, uint64_t now)
+{
+    while (size) {
+        if (frame.empty()) {
+            frame_start = now;
+        }
+        size_t room = max_frame - frame.size();
+        if (length && length - frame.size() < room) {
+            room = length - frame.size();
+        }
+        size_t take = (size < room) ? size : room;
+        int reason = 0;
+        if (delimiter != -1) {
+            const char *hit = (const char *) memchr(data, delimiter, take);
+            if (hit) {
+                take = hit - data + 1;
+                reason = FRAME_DELIMITER;
+            }
+        }
+        frame.append(data, take);
+        data += take;
+        size -= take;
+        last_byte = now;
+        if (!reason) {
+            if (length && frame.size() == length) {
+                reason = FRAME_LENGTH;
+            } else if (frame.size() == max_frame) {
+                reason = FRAME_OVERFLOW;
+            }
+        }
+        if (reason) {
+            Finish(reason);
+        }
+    }
+}
+
+
+/**
+ * Thread main loop - wait for data or the gap deadline of the current frame.
+ */
+void TtyFramer::Run()
+{
+    char buf[FRAMER_READ_SIZE];
+    struct pollfd fds[2];
+    fds[0].fd = fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = wake_pipe[0];
+    fds[1].events = POLLIN;
+    bool done = false;
+    while (!done && !closing) {
+        int64_t timeout = -1;
+        if (gap && !frame.empty()) {
+            uint64_t now = now_ns();
+            timeout = (last_byte + gap > now) ? (int64_t) (last_byte + gap - now) : 0;
+        }
+        fds[0].revents = fds[1].revents = 0;
+        #ifdef TTY_FRAMER_PPOLL
+        struct timespec ts;
+        ts.tv_sec = timeout / 1000000000;
+        ts.tv_nsec = timeout % 1000000000;
+        int n = ppoll(fds, 2, (timeout < 0) ? NULL : &ts, NULL);
+        #else
+        int n = poll(fds, 2, (timeout < 0) ? -1 : (int) ((timeout + 999999) / 1000000));
+        #endif
+        uint64_t now = now_ns();
+        if (closing) {
+            break;
+        }
+        if (n == -1 && errno != EINTR) {
+            int end = -errno;
+            if (!frame.empty()) {
+                Finish(FRAME_FLUSH);
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            ended = true;
+            status = end;
+            done = true;
+        }
+        if (fds[1].revents) {
+            char c[64];
+            while (read(wake_pipe[0], c, sizeof(c)) > 0) {}
+        }
+
+        // bytes arriving now came after the gap
+        completed = false;
+        if (gap && !frame.empty() && now - last_byte >= gap) {
+            Finish(FRAME_GAP);
+        }
+        while (!done && fds[0].revents) {
+            ssize_t res;
+            TEMP_FAILURE_RETRY(res = read(fd, buf, FRAMER_READ_SIZE));
+            if (res > 0) {
+                Feed(buf, res, now);
+                continue;
+            }
+            if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            // EOF, EIO (pty master with all slave ends closed) or error
+            int end = (res == 0 || errno == EIO) ? 0 : -errno;
+            if (!frame.empty()) {
+                Finish(FRAME_FLUSH);
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            ended = true;
+            status = end;
+            done = true;
+        }
+        if (completed || done) {
+            uv_async_send(async);
+        }
+    }
+}
+
+
+/**
+ * Report completed frames with a single callback (event loop thread).
+ */
+void TtyFramer::OnAsync(uv_async_t *handle)
+{
+    TtyFramer *framer = static_cast<TtyFramer *>(handle->data);
+    if (!framer || framer->closed) {
+        return;
+    }
+    std::string data;
+    std::vector<Frame> frames;
+    bool ended;
+    int status;
+    {
+        std::lock_guard<std::mutex> guard(framer->lock);
+        data.swap(framer->pending_data);
+        frames.swap(framer->pending);
+        ended = framer->ended;
+        status = framer->status;
+    }
+    if (frames.empty() && !ended) {
+        return;
+    }
+    Nan::HandleScope scope;
+    Local<ArrayBuffer> buffer = ArrayBuffer::New(v8::Isolate::GetCurrent(), frames.size() * sizeof(Frame));
+    Local<Float64Array> array = Float64Array::New(buffer, 0, frames.size() * 5);
+    if (frames.size()) {
+        Nan::TypedArrayContents<double> contents(array);
+        memcpy(*contents, &frames[0], frames.size() * sizeof(Frame));
+    }
+    Local<Value> argv[] = {
+        Nan::CopyBuffer(data.data(), data.size()).ToLocalChecked(),
+        array,
+        ended ? Local<Value>(Nan::New<Number>(status)) : Local<Value>(Nan::Undefined())
+    };
+    // JS might drop the last reference from within the callback
+    framer->Ref();
+    framer->callback.Call(framer->handle(), 3, argv, framer->async_resource);
+    framer->Unref();
+    if (ended) {
+        framer->Shutdown();
+    }
+}
+
+
+void TtyFramer::Wake()
+{
+    char c = 0;
+    int res = write(wake_pipe[1], &c, 1);
+    (void) res;
+}
+
+
+void TtyFramer::Shutdown()
+{
+    if (closed) {
+        return;
+    }
+    closing = true;
+    if (wake_pipe[1] != -1) {
+        Wake();
+    }
+    if (thread.joinable()) {
+        thread.join();
+    }
+    closed = true;
+    if (async) {
+        async->data = NULL;
+        uv_close((uv_handle_t *) async, [](uv_handle_t *handle) { delete (uv_async_t *) handle; });
+        async = NULL;
+        // pinned since New
+        Unref();
+    }
+    pending.clear();
+    pending_data.clear();
+    for (int i = 0; i < 2; ++i) {
+        if (wake_pipe[i] != -1) {
+            close(wake_pipe[i]);
+            wake_pipe[i] = -1;
+        }
+    }
+}
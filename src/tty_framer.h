@@ -0,0 +1,94 @@
+/* tty_framer.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TTY_FRAMER_H
+#define TTY_FRAMER_H
+
+#include "node_termios.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// reasons for the end of a frame
+#define FRAME_GAP 1         // no byte for gap microseconds
+#define FRAME_DELIMITER 2   // delimiter byte (included in the frame)
+#define FRAME_LENGTH 3      // fixed frame length reached
+#define FRAME_OVERFLOW 4    // max_frame reached without another rule
+#define FRAME_FLUSH 5       // fd removed, EOF or error
+
+/**
+ * TtyFramer - splits the input of a tty into frames on a dedicated thread.
+ *
+ * Arrivals are timestamped with CLOCK_MONOTONIC right after the thread
+ * woke up for them. A frame ends after an inter-byte gap (e.g. 3.5 character
+ * times for Modbus RTU, the kernel's VTIME only has 1/10 s resolution),
+ * at a delimiter byte or at a fixed length, whichever comes first.
+ * On Linux waits have nanosecond resolution (ppoll), elsewhere milliseconds.
+ *
+ * Completed frames are reported once per event loop turn (uv_async) as
+ * a single buffer holding all frame data and a Float64Array with
+ * (offset, length, start_us, end_us, reason) per frame. The end of the fd
+ * is reported with a status argument (0: EOF, otherwise -errno).
+ */
+class TtyFramer : public Nan::ObjectWrap {
+public:
+    static NAN_MODULE_INIT(Init);
+
+private:
+    struct Frame {
+        double offset;
+        double length;
+        double start;       // usec of first byte
+        double end;         // usec of last byte
+        double reason;
+    };
+
+    TtyFramer(int fd, uint64_t gap, int delimiter, size_t length, size_t max_frame);
+    ~TtyFramer();
+
+    static NAN_METHOD(New);
+    static NAN_METHOD(Close);
+
+    static void OnAsync(uv_async_t *handle);
+    void Run();
+    void Feed(const char *data, size_t size, uint64_t now);
+    void Finish(int reason);
+    void Wake();
+    void Shutdown();
+
+    int fd;
+    uint64_t gap;           // nsec, 0 for none
+    int delimiter;          // -1 for none
+    size_t length;          // 0 for none
+    size_t max_frame;
+
+    // thread only
+    std::string frame;
+    uint64_t frame_start;
+    uint64_t last_byte;
+    bool completed;         // frames finished since the last wakeup
+
+    // guarded by lock
+    std::string pending_data;
+    std::vector<Frame> pending;
+    bool ended;
+    int status;
+    std::mutex lock;
+
+    std::thread thread;
+    int wake_pipe[2];
+    std::atomic<bool> closing;
+    bool closed;
+    uv_async_t *async;
+    Nan::Callback callback;
+    Nan::AsyncResource *async_resource;
+};
+
+#endif // TTY_FRAMER_H
@@ -0,0 +1,522 @@
+/* tty_mux.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "tty_mux.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#define TTY_MUX_EPOLL
+#endif
+
+// max. events / reads handled per wakeup
+#define MUX_EVENTS 64
+
+
+static uint64_t now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+static int set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || (!(flags & O_NONBLOCK) && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)) {
+        return -1;
+    }
+    return 0;
+}
+
+
+NAN_MODULE_INIT(TtyMux::Init)
+{
+    Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New<String>("TtyMux").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+    Nan::SetPrototypeMethod(tpl, "add", Add);
+    Nan::SetPrototypeMethod(tpl, "remove", Remove);
+    Nan::SetPrototypeMethod(tpl, "release", Release);
+    Nan::SetPrototypeMethod(tpl, "close", Close);
+    MODULE_EXPORT("TtyMux", Nan::GetFunction(tpl).ToLocalChecked());
+}
+
+
+TtyMux::TtyMux(char *base, size_t chunk_size, size_t slots)
+    : base(base), chunk_size(chunk_size), busy(slots, false), held(0), epoll_fd(-1),
+      closing(false), closed(false), async(NULL), async_resource(NULL)
+{
+    wake_pipe[0] = wake_pipe[1] = -1;
+    // hand out lower slots first
+    for (size_t i = slots; i > 0; --i) {
+        free_slots.push_back(i - 1);
+    }
+}
+
+
+TtyMux::~TtyMux()
+{
+    Shutdown();
+    slab.Reset();
+    delete async_resource;
+}
+
+
+NAN_METHOD(TtyMux::New)
+{
+    if (!info.IsConstructCall()) {
+        return Nan::ThrowError("TtyMux must be called with new");
+    }
+    if (info.Length() != 3 || !info[0]->IsObject() || !info[1]->IsNumber() || !info[2]->IsFunction()) {
+        return Nan::ThrowError("usage: new termios.TtyMux(slab, chunk_size, callback)");
+    }
+    if (!Buffer::HasInstance(info[0])) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    int chunk_size = Nan::To<int>(info[1]).FromJust();
+    size_t length = Buffer::Length(info[0]);
+    if (chunk_size <= 0 || length < (size_t) chunk_size || length % chunk_size) {
+        return Nan::ThrowError("slab length must be a multiple of chunk_size");
+    }
+
+    TtyMux *mux = new TtyMux(Buffer::Data(info[0]), chunk_size, length / chunk_size);
+    if (pipe(mux->wake_pipe) || set_nonblocking(mux->wake_pipe[0]) || set_nonblocking(mux->wake_pipe[1])) {
+        std::string error(strerror(errno));
+        delete mux;
+        return Nan::ThrowError((std::string("TtyMux failed - ") + error).c_str());
+    }
+    fcntl(mux->wake_pipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(mux->wake_pipe[1], F_SETFD, FD_CLOEXEC);
+    #ifdef TTY_MUX_EPOLL
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = mux->wake_pipe[0];
+    if ((mux->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1
+            || epoll_ctl(mux->epoll_fd, EPOLL_CTL_ADD, mux->wake_pipe[0], &event)) {
+        std::string error(strerror(errno));
+        delete mux;
+        return Nan::ThrowError((std::string("TtyMux failed - ") + error).c_str());
+    }
+    #endif
+
+    mux->async = new uv_async_t;
+    uv_async_init(Nan::GetCurrentEventLoop(), mux->async, OnAsync);
+    mux->async->data = mux;
+    // referenced by UpdateRef while there are fds
+    uv_unref((uv_handle_t *) mux->async);
+    mux->slab.Reset(info[0].As<Object>());
+    mux->callback.Reset(info[2].As<Function>());
+    mux->async_resource = new Nan::AsyncResource("termios:TtyMux");
+    mux->Wrap(info.This());
+    mux->thread = std::thread(&TtyMux::Run, mux);
+    info.GetReturnValue().Set(info.This());
+}
+
+
+/**
+ * Watch `fd`, optionally holding back data as VMIN / VTIME would.
+ * The fd is switched to nonblocking mode.
+ */
+NAN_METHOD(TtyMux::Add)
+{
+    TtyMux *mux = Nan::ObjectWrap::Unwrap<TtyMux>(info.Holder());
+    if (info.Length() < 1 || info.Length() > 3 || !info[0]->IsInt32()
+            || (info.Length() > 1 && !info[1]->IsUint32())
+            || (info.Length() > 2 && !info[2]->IsUint32())) {
+        return Nan::ThrowError("usage: mux.add(fd, vmin?, vtime?)");
+    }
+    if (mux->closed) {
+        return Nan::ThrowError("TtyMux is closed");
+    }
+    int fd = int32_arg(info[0]);
+    Port port;
+    port.fd = fd;
+    port.vmin = (info.Length() > 1) ? Nan::To<uint32_t>(info[1]).FromJust() : 0;
+    port.vtime = (info.Length() > 2) ? Nan::To<uint32_t>(info[2]).FromJust() : 0;
+    port.slot = -1;
+    port.filled = 0;
+    port.deadline = 0;
+    if (port.vmin > mux->chunk_size) {
+        port.vmin = mux->chunk_size;
+    }
+    {
+        std::lock_guard<std::mutex> guard(mux->lock);
+        if (mux->ports.count(fd)) {
+            return Nan::ThrowError("add failed - fd already added");
+        }
+        if (set_nonblocking(fd)) {
+            std::string error(strerror(errno));
+            return Nan::ThrowError((std::string("add failed - ") + error).c_str());
+        }
+        #ifdef TTY_MUX_EPOLL
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(mux->epoll_fd, EPOLL_CTL_ADD, fd, &event)) {
+            std::string error(strerror(errno));
+            return Nan::ThrowError((std::string("add failed - ") + error).c_str());
+        }
+        #endif
+        mux->ports[fd] = port;
+    }
+    mux->Wake();
+    mux->UpdateRef();
+    info.GetReturnValue().SetUndefined();
+}
+
+
+/**
+ * Stop watching `fd`. Data held back for VMIN / VTIME is still reported.
+ */
+NAN_METHOD(TtyMux::Remove)
+{
+    TtyMux *mux = Nan::ObjectWrap::Unwrap<TtyMux>(info.Holder());
+    if (info.Length() != 1 || !info[0]->IsInt32()) {
+        return Nan::ThrowError("usage: mux.remove(fd)");
+    }
+    if (mux->closed) {
+        // all fds are gone already
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(mux->lock);
+        mux->RemovePort(int32_arg(info[0]));
+    }
+    mux->Wake();
+    uv_async_send(mux->async);
+    mux->UpdateRef();
+    info.GetReturnValue().SetUndefined();
+}
+
+
+NAN_METHOD(TtyMux::Release)
+{
+    TtyMux *mux = Nan::ObjectWrap::Unwrap<TtyMux>(info.Holder());
+    if (info.Length() != 1 || !info[0]->IsNumber()) {
+        return Nan::ThrowError("usage: mux.release(slot)");
+    }
+    if (mux->closed) {
+        return;
+    }
+    int slot = Nan::To<int>(info[0]).FromJust();
+    {
+        std::lock_guard<std::mutex> guard(mux->lock);
+        if (slot < 0 || (size_t) slot >= mux->busy.size() || !mux->busy[slot]) {
+            return Nan::ThrowError("invalid slot");
+        }
+        mux->busy[slot] = false;
+        mux->free_slots.push_back(slot);
+    }
+    mux->slot_freed.notify_one();
+    info.GetReturnValue().SetUndefined();
+}
+
+
+NAN_METHOD(TtyMux::Close)
+{
+    TtyMux *mux = Nan::ObjectWrap::Unwrap<TtyMux>(info.Holder());
+    mux->Shutdown();
+    info.GetReturnValue().SetUndefined();
+}
+
+
+// called by the lock holder
+void TtyMux::RemovePort(int fd)
+{
+    std::map<int, Port>::iterator it = ports.find(fd);
+    if (it == ports.end()) {
+        return;
+    }
+    #ifdef TTY_MUX_EPOLL
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    #endif
+    if (it->second.filled) {
+        Deliver(it->second);
+    } else if (it->second.slot != -1) {
+        ReturnSlot(it->second);
+    }
+    ports.erase(it);
+}
+
+
+// give back an empty slot of a port (called by the lock holder)
+void TtyMux::ReturnSlot(Port &port)
+{
+    free_slots.push_back(port.slot);
+    busy[port.slot] = false;
+    port.slot = -1;
+    held--;
+    slot_freed.notify_one();
+}
+
+
+// called by the lock holder
+void TtyMux::Deliver(Port &port)
+{
+    Record record = {port.fd, port.slot, (int) port.filled};
+    pending.push_back(record);
+    port.slot = -1;
+    held--;
+    port.filled = 0;
+    port.deadline = 0;
+}
+
+
+/**
+ * Read from a readable fd until it would block (called by the lock holder).
+ * EOF and EIO (pty master with all slave ends closed) are reported as end.
+ *
+ * At most slots - 1 slots are held back for VMIN / VTIME, a port filling
+ * the last one gets delivered short. Otherwise ports waiting for more data
+ * could take all slots and no fd would be read anymore.
+ */
+void TtyMux::ReadPort(Port &port, uint64_t now)
+{
+    size_t threshold = port.vmin ? port.vmin : 1;
+    for (;;) {
+        if (port.slot == -1) {
+            if (free_slots.empty()) {
+                return;
+            }
+            port.slot = free_slots.back();
+            free_slots.pop_back();
+            busy[port.slot] = true;
+            held++;
+        }
+        int n;
+        TEMP_FAILURE_RETRY(n = read(port.fd, base + port.slot * chunk_size + port.filled, chunk_size - port.filled));
+        if (n > 0) {
+            port.filled += n;
+            if (port.filled >= threshold) {
+                Deliver(port);
+            } else if (port.vtime) {
+                // inter-byte timer
+                port.deadline = now + port.vtime * 100;
+            }
+            continue;
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!port.filled) {
+                ReturnSlot(port);
+            } else if (held == busy.size()) {
+                Deliver(port);
+            }
+            return;
+        }
+        Record record = {port.fd, -1, (n == 0 || errno == EIO) ? 0 : -errno};
+        RemovePort(port.fd);
+        pending.push_back(record);
+        return;
+    }
+}
+
+
+// poll timeout for the next VTIME deadline (called by the lock holder)
+int TtyMux::NextTimeout(uint64_t now)
+{
+    uint64_t next = 0;
+    for (std::map<int, Port>::iterator it = ports.begin(); it != ports.end(); ++it) {
+        if (it->second.deadline && (!next || it->second.deadline < next)) {
+            next = it->second.deadline;
+        }
+    }
+    if (!next) {
+        return -1;
+    }
+    return (next > now) ? (int) (next - now) : 0;
+}
+
+
+/**
+ * Thread main loop - wait for readable fds, read them and
+ * hand the filled slots over to the event loop thread.
+ */
+void TtyMux::Run()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    std::vector<int> ready;
+    #ifdef TTY_MUX_EPOLL
+    struct epoll_event events[MUX_EVENTS];
+    #else
+    std::vector<struct pollfd> fds;
+    #endif
+    while (!closing) {
+        int timeout = NextTimeout(now_ms());
+        ready.clear();
+        #ifdef TTY_MUX_EPOLL
+        guard.unlock();
+        int n = epoll_wait(epoll_fd, events, MUX_EVENTS, timeout);
+        guard.lock();
+        for (int i = 0; i < n; ++i) {
+            ready.push_back(events[i].data.fd);
+        }
+        #else
+        fds.clear();
+        struct pollfd wake = {wake_pipe[0], POLLIN, 0};
+        fds.push_back(wake);
+        for (std::map<int, Port>::iterator it = ports.begin(); it != ports.end(); ++it) {
+            struct pollfd entry = {it->first, POLLIN, 0};
+            fds.push_back(entry);
+        }
+        guard.unlock();
+        int n = poll(&fds[0], fds.size(), timeout);
+        guard.lock();
+        for (size_t i = 0; n > 0 && i < fds.size(); ++i) {
+            if (fds[i].revents) {
+                ready.push_back(fds[i].fd);
+            }
+        }
+        #endif
+        if (closing) {
+            break;
+        }
+
+        uint64_t now = now_ms();
+        bool starved = false;
+        for (size_t i = 0; i < ready.size(); ++i) {
+            if (ready[i] == wake_pipe[0]) {
+                char buf[64];
+                while (read(wake_pipe[0], buf, sizeof(buf)) > 0) {}
+                continue;
+            }
+            std::map<int, Port>::iterator it = ports.find(ready[i]);
+            if (it != ports.end()) {
+                ReadPort(it->second, now);
+                starved |= free_slots.empty();
+            }
+        }
+        for (std::map<int, Port>::iterator it = ports.begin(); it != ports.end(); ++it) {
+            if (it->second.deadline && it->second.deadline <= now && it->second.filled) {
+                Deliver(it->second);
+            }
+        }
+
+        if (!pending.empty()) {
+            uv_async_send(async);
+        }
+        // level triggered fds would spin without free slots,
+        // wait for JS to release one, but not beyond the next VTIME deadline
+        if (starved && free_slots.empty() && !closing) {
+            int wait = NextTimeout(now_ms());
+            if (wait < 0) {
+                slot_freed.wait(guard);
+            } else {
+                slot_freed.wait_for(guard, std::chrono::milliseconds(wait));
+            }
+        }
+    }
+}
+
+
+/**
+ * Report pending records with a single callback (event loop thread).
+ */
+void TtyMux::OnAsync(uv_async_t *handle)
+{
+    TtyMux *mux = static_cast<TtyMux *>(handle->data);
+    if (!mux || mux->closed) {
+        return;
+    }
+    std::vector<Record> records;
+    {
+        std::lock_guard<std::mutex> guard(mux->lock);
+        records.swap(mux->pending);
+    }
+    if (records.empty()) {
+        return;
+    }
+    Nan::HandleScope scope;
+    Local<ArrayBuffer> buffer = ArrayBuffer::New(v8::Isolate::GetCurrent(), records.size() * 3 * sizeof(int32_t));
+    Local<Int32Array> array = Int32Array::New(buffer, 0, records.size() * 3);
+    Nan::TypedArrayContents<int32_t> contents(array);
+    memcpy(*contents, &records[0], records.size() * sizeof(Record));
+    Local<Value> argv[] = {array};
+    // JS might drop the last reference from within the callback
+    mux->Ref();
+    mux->callback.Call(mux->handle(), 1, argv, mux->async_resource);
+    mux->Unref();
+    mux->UpdateRef();
+}
+
+
+void TtyMux::Wake()
+{
+    char c = 0;
+    int res = write(wake_pipe[1], &c, 1);
+    (void) res;
+}
+
+
+/**
+ * Keep the event loop alive and the JS object pinned
+ * while there are fds to watch.
+ */
+void TtyMux::UpdateRef()
+{
+    if (closed) {
+        return;
+    }
+    bool active;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        active = !ports.empty();
+    }
+    if (active && !uv_has_ref((uv_handle_t *) async)) {
+        uv_ref((uv_handle_t *) async);
+        Ref();
+    } else if (!active && uv_has_ref((uv_handle_t *) async)) {
+        uv_unref((uv_handle_t *) async);
+        Unref();
+    }
+}
+
+
+void TtyMux::Shutdown()
+{
+    if (closed) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        closing = true;
+    }
+    if (wake_pipe[1] != -1) {
+        Wake();
+    }
+    slot_freed.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    closed = true;
+    if (async) {
+        if (uv_has_ref((uv_handle_t *) async)) {
+            Unref();
+        }
+        async->data = NULL;
+        uv_close((uv_handle_t *) async, [](uv_handle_t *handle) { delete (uv_async_t *) handle; });
+        async = NULL;
+    }
+    ports.clear();
+    pending.clear();
+    if (epoll_fd != -1) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (wake_pipe[i] != -1) {
+            close(wake_pipe[i]);
+            wake_pipe[i] = -1;
+        }
+    }
+}
@@ -0,0 +1,95 @@
+/* tty_mux.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TTY_MUX_H
+#define TTY_MUX_H
+
+#include "node_termios.h"
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+
+/**
+ * TtyMux - reads many tty fds from a single thread.
+ *
+ * The fds are watched by a dedicated thread (epoll on Linux, poll elsewhere)
+ * and read into slots of a single slab owned by JS, as with TtyReader.
+ * Filled slots are collected and reported with one callback per event loop
+ * turn (uv_async) as Int32Array of (fd, slot, length) triples. Slot -1 marks
+ * the end of an fd (length 0: EOF, otherwise -errno), the fd is removed then.
+ * JS must `release` reported slots. If all slots are in use, reading pauses.
+ *
+ * Like a blocking read in noncanonical mode, data is held back per fd
+ * until `vmin` bytes arrived, or for `vmin` and `vtime` set, until no
+ * further byte arrived for `vtime` tenths of a second. At most slots - 1
+ * slots are held back this way, a port needing the last one gets delivered short.
+ */
+class TtyMux : public Nan::ObjectWrap {
+public:
+    static NAN_MODULE_INIT(Init);
+
+private:
+    struct Port {
+        int fd;
+        size_t vmin;
+        unsigned vtime;     // 1/10 s
+        int slot;           // slot being filled, -1 for none
+        size_t filled;
+        uint64_t deadline;  // msec, 0 for none
+    };
+
+    struct Record {
+        int fd;
+        int slot;
+        int length;
+    };
+
+    TtyMux(char *base, size_t chunk_size, size_t slots);
+    ~TtyMux();
+
+    static NAN_METHOD(New);
+    static NAN_METHOD(Add);
+    static NAN_METHOD(Remove);
+    static NAN_METHOD(Release);
+    static NAN_METHOD(Close);
+
+    static void OnAsync(uv_async_t *handle);
+    void Run();
+    void ReadPort(Port &port, uint64_t now);
+    void Deliver(Port &port);
+    void RemovePort(int fd);
+    void ReturnSlot(Port &port);
+    int NextTimeout(uint64_t now);
+    void Wake();
+    void Shutdown();
+    void UpdateRef();
+
+    char *base;
+    size_t chunk_size;
+    std::vector<int> free_slots;
+    std::vector<bool> busy;
+    size_t held;        // slots held by ports, not yet delivered
+    std::map<int, Port> ports;
+    std::vector<Record> pending;
+    std::mutex lock;
+    std::condition_variable slot_freed;
+    std::thread thread;
+    int wake_pipe[2];
+    int epoll_fd;       // -1 without epoll
+    bool closing;
+    bool closed;
+    uv_async_t *async;
+    Nan::Persistent<Object> slab;
+    Nan::Callback callback;
+    Nan::AsyncResource *async_resource;
+};
+
+#endif // TTY_MUX_H
@@ -0,0 +1,265 @@
+/* tty_reader.cpp
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#include "tty_reader.h"
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+#ifndef TIOCPKT_DATA
+#define TIOCPKT_DATA 0
+#endif
+
+
+NAN_MODULE_INIT(TtyReader::Init)
+{
+    Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New<String>("TtyReader").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+    Nan::SetPrototypeMethod(tpl, "start", Start);
+    Nan::SetPrototypeMethod(tpl, "stop", Stop);
+    Nan::SetPrototypeMethod(tpl, "release", Release);
+    Nan::SetPrototypeMethod(tpl, "close", Close);
+    MODULE_EXPORT("TtyReader", Nan::GetFunction(tpl).ToLocalChecked());
+}
+
+
+TtyReader::TtyReader(int fd, char *base, size_t chunk_size, size_t slots, bool packet)
+    : fd(fd), base(base), chunk_size(chunk_size), packet(packet), busy(slots, false), poll(NULL),
+      wanted(false), polling(false), referenced(false), closed(false), async_resource(NULL)
+{
+    // hand out lower slots first
+    for (size_t i = slots; i > 0; --i) {
+        free_slots.push_back(i - 1);
+    }
+}
+
+
+TtyReader::~TtyReader()
+{
+    CloseHandle();
+    slab.Reset();
+    delete async_resource;
+}
+
+
+NAN_METHOD(TtyReader::New)
+{
+    if (!info.IsConstructCall()) {
+        return Nan::ThrowError("TtyReader must be called with new");
+    }
+    if (info.Length() < 4 || info.Length() > 5
+          || !info[0]->IsNumber()
+          || !info[1]->IsObject()
+          || !info[2]->IsNumber()
+          || !info[3]->IsFunction()
+          || (info.Length() == 5 && !info[4]->IsBoolean())) {
+        return Nan::ThrowError("usage: new termios.TtyReader(fd, slab, chunk_size, callback, packet?)");
+    }
+    if (!Buffer::HasInstance(info[1])) {
+        return Nan::ThrowError("wrong buffer type");
+    }
+    int fd = Nan::To<int>(info[0]).FromJust();
+    int chunk_size = Nan::To<int>(info[2]).FromJust();
+    size_t length = Buffer::Length(info[1]);
+    if (chunk_size <= 0 || length < (size_t) chunk_size || length % chunk_size) {
+        return Nan::ThrowError("slab length must be a multiple of chunk_size");
+    }
+    bool packet = info.Length() == 5 && Nan::To<bool>(info[4]).FromJust();
+    if (packet && chunk_size < 2) {
+        return Nan::ThrowError("chunk_size too small for packet mode");
+    }
+
+    // note: uv_poll_init switches the fd to nonblocking mode
+    uv_poll_t *poll = new uv_poll_t;
+    int err = uv_poll_init(Nan::GetCurrentEventLoop(), poll, fd);
+    if (err) {
+        delete poll;
+        return Nan::ThrowError((std::string("TtyReader failed - ") + uv_strerror(err)).c_str());
+    }
+
+    TtyReader *reader = new TtyReader(fd, Buffer::Data(info[1]), chunk_size, length / chunk_size, packet);
+    reader->poll = poll;
+    poll->data = reader;
+    reader->slab.Reset(info[1].As<Object>());
+    reader->callback.Reset(info[3].As<Function>());
+    reader->async_resource = new Nan::AsyncResource("termios:TtyReader");
+    reader->Wrap(info.This());
+    info.GetReturnValue().Set(info.This());
+}
+
+
+NAN_METHOD(TtyReader::Start)
+{
+    TtyReader *reader = Nan::ObjectWrap::Unwrap<TtyReader>(info.Holder());
+    if (reader->closed) {
+        return Nan::ThrowError("TtyReader is closed");
+    }
+    reader->wanted = true;
+    // keep JS object alive while we might report data
+    if (!reader->referenced) {
+        reader->referenced = true;
+        reader->Ref();
+    }
+    reader->UpdatePolling();
+    info.GetReturnValue().SetUndefined();
+}
+
+
+NAN_METHOD(TtyReader::Stop)
+{
+    TtyReader *reader = Nan::ObjectWrap::Unwrap<TtyReader>(info.Holder());
+    reader->wanted = false;
+    reader->UpdatePolling();
+    if (reader->referenced) {
+        reader->referenced = false;
+        reader->Unref();
+    }
+    info.GetReturnValue().SetUndefined();
+}
+
+
+NAN_METHOD(TtyReader::Release)
+{
+    TtyReader *reader = Nan::ObjectWrap::Unwrap<TtyReader>(info.Holder());
+    if (info.Length() != 1 || !info[0]->IsNumber()) {
+        return Nan::ThrowError("usage: reader.release(slot)");
+    }
+    int slot = Nan::To<int>(info[0]).FromJust();
+    if (slot < 0 || (size_t) slot >= reader->busy.size() || !reader->busy[slot]) {
+        return Nan::ThrowError("invalid slot");
+    }
+    reader->busy[slot] = false;
+    reader->free_slots.push_back(slot);
+    reader->UpdatePolling();
+    info.GetReturnValue().SetUndefined();
+}
+
+
+NAN_METHOD(TtyReader::Close)
+{
+    TtyReader *reader = Nan::ObjectWrap::Unwrap<TtyReader>(info.Holder());
+    reader->CloseHandle();
+    info.GetReturnValue().SetUndefined();
+}
+
+
+void TtyReader::OnPoll(uv_poll_t *handle, int status, int events)
+{
+    // only polled for UV_READABLE
+    (void) events;
+    TtyReader *reader = static_cast<TtyReader *>(handle->data);
+    if (!reader || reader->closed) {
+        return;
+    }
+    // JS might drop the last reference from within the callback
+    reader->Ref();
+    if (status < 0) {
+        reader->Emit(-status, -1, 0);
+        reader->CloseHandle();
+    } else {
+        reader->ReadAvailable();
+    }
+    reader->Unref();
+}
+
+
+/**
+ * Read into free slots until the fd would block.
+ * Reports EOF as slot -1, which also happens for EIO
+ * (pty master with all slave ends closed on Linux).
+ *
+ * In packet mode the first byte of a read is the control byte.
+ * The slot stays free for control only packets, data packets are
+ * reported with the length of the data behind the control byte.
+ */
+void TtyReader::ReadAvailable()
+{
+    while (!closed && wanted && !free_slots.empty()) {
+        int slot = free_slots.back();
+        int n;
+        TEMP_FAILURE_RETRY(n = read(fd, base + slot * chunk_size, chunk_size));
+        if (n > 0) {
+            if (packet) {
+                int control = (unsigned char) base[slot * chunk_size];
+                if (control != TIOCPKT_DATA) {
+                    Emit(0, -1, 0, control);
+                    continue;
+                }
+                if (n == 1) {
+                    continue;
+                }
+            }
+            free_slots.pop_back();
+            busy[slot] = true;
+            Emit(0, slot, (packet) ? n - 1 : n);
+            continue;
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (n == 0 || errno == EIO) {
+            Emit(0, -1, 0);
+        } else {
+            Emit(errno, -1, 0);
+        }
+        CloseHandle();
+        return;
+    }
+    UpdatePolling();
+}
+
+
+void TtyReader::Emit(int err, int slot, size_t length, int control)
+{
+    Nan::HandleScope scope;
+    Local<Value> argv[] = {
+        Nan::Null(),
+        Nan::New<Number>(slot),
+        Nan::New<Number>(length),
+        Nan::New<Number>(control)
+    };
+    if (err) {
+        std::string error(strerror(err));
+        argv[0] = Nan::Error((std::string("read failed - ") + error).c_str());
+    }
+    callback.Call(handle(), 4, argv, async_resource);
+}
+
+
+void TtyReader::UpdatePolling()
+{
+    if (closed) {
+        return;
+    }
+    bool should_poll = wanted && !free_slots.empty();
+    if (should_poll && !polling) {
+        polling = !uv_poll_start(poll, UV_READABLE, OnPoll);
+    } else if (!should_poll && polling) {
+        uv_poll_stop(poll);
+        polling = false;
+    }
+}
+
+
+void TtyReader::CloseHandle()
+{
+    if (closed) {
+        return;
+    }
+    closed = true;
+    wanted = false;
+    polling = false;
+    poll->data = NULL;
+    uv_close((uv_handle_t *) poll, [](uv_handle_t *handle) { delete (uv_poll_t *) handle; });
+    poll = NULL;
+    if (referenced) {
+        referenced = false;
+        Unref();
+    }
+}
@@ -0,0 +1,63 @@
+/* tty_reader.h
+ *
+ * Copyright (C) 2017, 2020 Joerg Breitbart
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+#ifndef TTY_READER_H
+#define TTY_READER_H
+
+#include "node_termios.h"
+#include <vector>
+
+/**
+ * TtyReader - reads a tty fd into a preallocated ring of slots.
+ *
+ * The ring memory is a single Buffer (slab) owned by JS, that gets split
+ * into `chunk_size` slots. Data is read by the event loop thread directly
+ * into a free slot and reported as (slot, length) to JS, which creates
+ * a zero-copy view on the slab. JS must `release` the slot once consumed.
+ * If all slots are in use, polling stops until a slot gets released.
+ *
+ * In packet mode (pty master with TIOCPKT enabled) the leading control byte
+ * of every read is split off: data is reported behind that byte in the slot,
+ * control only packets are reported with slot -1 and the control byte.
+ */
+class TtyReader : public Nan::ObjectWrap {
+public:
+    static NAN_MODULE_INIT(Init);
+
+private:
+    TtyReader(int fd, char *base, size_t chunk_size, size_t slots, bool packet);
+    ~TtyReader();
+
+    static NAN_METHOD(New);
+    static NAN_METHOD(Start);
+    static NAN_METHOD(Stop);
+    static NAN_METHOD(Release);
+    static NAN_METHOD(Close);
+
+    static void OnPoll(uv_poll_t *handle, int status, int events);
+    void ReadAvailable();
+    void Emit(int err, int slot, size_t length, int control = 0);
+    void UpdatePolling();
+    void CloseHandle();
+
+    int fd;
+    char *base;
+    size_t chunk_size;
+    bool packet;        // TIOCPKT framing
+    std::vector<int> free_slots;
+    std::vector<bool> busy;
+    uv_poll_t *poll;
+    bool wanted;        // JS wants data (start/stop)
+    bool polling;       // poll handle is active
+    bool referenced;    // JS object is pinned while wanted
+    bool closed;
+    Nan::Persistent<Object> slab;
+    Nan::Callback callback;
+    Nan::AsyncResource *async_resource;
+};
+
+#endif // TTY_READER_H